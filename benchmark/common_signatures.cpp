@@ -0,0 +1,7 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#define MRBIND17_INSTANTIATE_COMMON_SIGNATURES
+#include <mrbind17/common_signatures.hpp>
@@ -0,0 +1,33 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+// Translation unit defining 2800 bindings, used to measure the cost of
+// instantiating the binding templates. Compile with USE_COMMON_SIGNATURES
+// defined to rely on the instantiations of common_signatures.cpp.
+#ifdef USE_COMMON_SIGNATURES
+#include <mrbind17/common_signatures.hpp>
+#else
+#include <mrbind17/mrbind17.hpp>
+#endif
+#include <string>
+
+#define BIND(i) \
+    mod.def_function("add" #i, [](int x, int y) { return x + y + i; }); \
+    mod.def_function("scale" #i, [](double x) { return x * i; }); \
+    mod.def_function("suffix" #i, [](const std::string& s) { return s + #i; }); \
+    mod.def_function("greater" #i, [](int x) { return x > i; });
+
+#define BIND10(i) \
+    BIND(i##0) BIND(i##1) BIND(i##2) BIND(i##3) BIND(i##4) \
+    BIND(i##5) BIND(i##6) BIND(i##7) BIND(i##8) BIND(i##9)
+
+#define BIND100(i) \
+    BIND10(i##0) BIND10(i##1) BIND10(i##2) BIND10(i##3) BIND10(i##4) \
+    BIND10(i##5) BIND10(i##6) BIND10(i##7) BIND10(i##8) BIND10(i##9)
+
+void bind_all(mrbind17::module& mod) {
+    BIND100(1) BIND100(2) BIND100(3) BIND100(4)
+    BIND100(5) BIND100(6) BIND100(7)
+}
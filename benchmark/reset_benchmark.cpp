@@ -0,0 +1,74 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+// Compares the cost of isolating scripts by rebuilding an interpreter
+// (mrb_close, mrb_open and all the bindings) with the cost of resetting
+// it to a checkpoint taken after the bindings were set up.
+#include <mrbind17/mrbind17.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+struct point {
+    double x = 0, y = 0;
+};
+
+static void setup(mrbind17::interpreter& mruby) {
+    for(int i = 0; i < 100; i++) {
+        std::string name = "f" + std::to_string(i);
+        mruby.def_function(name.c_str(), [](int a, int b) { return a + b; });
+    }
+    mruby.def_class<point>("Point")
+        .def_readwrite("x", &point::x)
+        .def_readwrite("y", &point::y);
+    mruby.def_function("norm2", [](const point& p) { return p.x*p.x + p.y*p.y; });
+    auto rules = mruby.def_module("Rules");
+    for(int i = 0; i < 20; i++) {
+        std::string name = "RULE_" + std::to_string(i);
+        rules.def_const(name.c_str(), i);
+    }
+    mruby.set_global("$threshold", 0.5);
+}
+
+static const char* script = R"ruby(
+  $seen = []
+  LOCAL_LIMIT = 100
+  class Handler
+    def call(p); p.x = 3.0; p.y = 4.0; norm2(p); end
+  end
+  def helper(n); f1(n, LOCAL_LIMIT); end
+  (1..50).each { |i| $seen << helper(i) }
+  Handler.new.call(Point.new)
+)ruby";
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000;
+    using clock = std::chrono::steady_clock;
+
+    auto start = clock::now();
+    for(int i = 0; i < iterations; i++) {
+        mrbind17::interpreter mruby;
+        setup(mruby);
+        mruby.execute(script);
+    }
+    std::chrono::duration<double, std::micro> rebuild = clock::now() - start;
+
+    mrbind17::interpreter mruby;
+    setup(mruby);
+    mruby.checkpoint();
+    start = clock::now();
+    for(int i = 0; i < iterations; i++) {
+        mruby.execute(script);
+        mruby.reset();
+    }
+    std::chrono::duration<double, std::micro> reset = clock::now() - start;
+
+    std::cout << "iterations:        " << iterations << "\n"
+              << "rebuild + execute: " << rebuild.count() / iterations << " us\n"
+              << "execute + reset:   " << reset.count() / iterations << " us\n"
+              << "speedup:           " << rebuild.count() / reset.count() << "x" << std::endl;
+    return 0;
+}
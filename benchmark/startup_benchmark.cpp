@@ -0,0 +1,71 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+// Reports the startup time and the memory used by an interpreter
+// created with mrb_open (all the gems linked into MRuby) and with
+// mrb_open_core (core classes only). Gems can be added to the core
+// configuration with MRBIND17_DECLARE_GEM / MRBIND17_GEM, e.g.
+//
+//   MRBIND17_DECLARE_GEM(mruby_print)
+//   options.gems = { MRBIND17_GEM(mruby_print) };
+#include <mrbind17/mrbind17.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+// Resident set size of the process, in bytes (Linux only)
+static size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if(!(statm >> pages >> resident)) return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static void setup(mrbind17::interpreter& mruby) {
+    mruby.def_function("add", [](int a, int b) { return a + b; });
+    mruby.execute("add(1, 2)");
+}
+
+static void report(const char* label, const mrbind17::interpreter_options& options, int count) {
+    std::vector<std::unique_ptr<mrbind17::interpreter>> interpreters;
+    interpreters.reserve(count);
+    size_t rss_before = resident_bytes();
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < count; i++) {
+        interpreters.push_back(std::make_unique<mrbind17::interpreter>(options));
+        setup(*interpreters.back());
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    size_t rss_after = resident_bytes();
+
+    mrbind17::interpreter_options tracked = options;
+    tracked.track_memory = true;
+    mrbind17::interpreter probe(tracked);
+    setup(probe);
+    auto stats = probe.get_memory_stats();
+
+    std::cout << label << ":\n"
+              << "  startup:            " << elapsed.count() / count << " us per interpreter\n"
+              << "  allocated by state: " << stats.current_bytes / 1024.0 << " KiB (peak "
+              << stats.peak_bytes / 1024.0 << " KiB)\n"
+              << "  resident growth:    " << (rss_after - rss_before) / 1024.0 / count
+              << " KiB per interpreter\n";
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    mrbind17::interpreter_options full;
+    report("mrb_open (all gems)", full, count);
+
+    mrbind17::interpreter_options core;
+    core.core_only = true;
+    report("mrb_open_core", core, count);
+    return 0;
+}
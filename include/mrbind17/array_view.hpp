@@ -0,0 +1,186 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_ARRAY_VIEW_H_
+#define MRBIND17_ARRAY_VIEW_H_
+
+#include <mrbind17/type_binder.hpp>
+#include <mrbind17/type_registry.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Converts an element of a collection view, throwing std::invalid_argument
+/// if the element does not have the expected type.
+template<typename T>
+T convert_element(mrb_state* mrb, mrb_value val, const char* what, mrb_int index) {
+  if(!type_binder<T>::check_type(mrb, val)) {
+    throw std::invalid_argument(std::string("Cannot convert ")
+        + mrb_obj_classname(mrb, val) + " into " + get_cpp_class_name<T>(mrb)
+        + " (" + what + " " + std::to_string(index) + ")");
+  }
+  return type_binder<T>::mrb_to_cpp(mrb, val);
+}
+
+} // namespace detail
+
+/**
+ * @brief The array_view class gives access to a Ruby Array from C++
+ * without converting it as a whole. Elements are converted into T only
+ * when accessed. An array_view can be used as the parameter type of a
+ * bound function; it is valid for the duration of the call.
+ *
+ * @tparam T C++ type of the elements.
+ */
+template<typename T>
+class array_view {
+
+  public:
+
+  using value_type      = T;
+  using size_type       = size_t;
+  using difference_type = std::ptrdiff_t;
+
+  /**
+   * @brief Random-access iterator converting elements on dereference.
+   */
+  class iterator {
+
+    public:
+
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = T;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = void;
+    using reference         = T;
+
+    iterator() = default;
+
+    T operator*() const { return (*m_view)[m_index]; }
+
+    T operator[](difference_type n) const { return (*m_view)[m_index + n]; }
+
+    iterator& operator++() { ++m_index; return *this; }
+    iterator  operator++(int) { auto it = *this; ++m_index; return it; }
+    iterator& operator--() { --m_index; return *this; }
+    iterator  operator--(int) { auto it = *this; --m_index; return it; }
+
+    iterator& operator+=(difference_type n) { m_index += n; return *this; }
+    iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+    iterator operator+(difference_type n) const { return iterator(m_view, m_index + n); }
+    iterator operator-(difference_type n) const { return iterator(m_view, m_index - n); }
+
+    friend iterator operator+(difference_type n, const iterator& it) { return it + n; }
+
+    difference_type operator-(const iterator& other) const { return m_index - other.m_index; }
+
+    bool operator==(const iterator& other) const { return m_index == other.m_index; }
+    bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+    bool operator< (const iterator& other) const { return m_index <  other.m_index; }
+    bool operator<=(const iterator& other) const { return m_index <= other.m_index; }
+    bool operator> (const iterator& other) const { return m_index >  other.m_index; }
+    bool operator>=(const iterator& other) const { return m_index >= other.m_index; }
+
+    private:
+
+    friend class array_view;
+
+    iterator(const array_view* view, difference_type index)
+    : m_view(view)
+    , m_index(index) {}
+
+    const array_view* m_view  = nullptr;
+    difference_type   m_index = 0;
+  };
+
+  using const_iterator = iterator;
+
+  array_view(mrb_state* mrb, mrb_value array)
+  : m_mrb(mrb)
+  , m_array(array) {}
+
+  size_t size() const { return RARRAY_LEN(m_array); }
+
+  bool empty() const { return size() == 0; }
+
+  /**
+   * @brief Converts the element at index i. Throws std::invalid_argument
+   * if the element cannot be converted into T.
+   */
+  T operator[](size_t i) const {
+    return detail::convert_element<T>(m_mrb, RARRAY_PTR(m_array)[i], "element", i);
+  }
+
+  /**
+   * @brief Same as operator[], with bounds checking
+   * (throws std::out_of_range).
+   */
+  T at(size_t i) const {
+    if(i >= size()) throw std::out_of_range("array_view index out of range");
+    return (*this)[i];
+  }
+
+  T front() const { return (*this)[0]; }
+
+  T back() const { return (*this)[size()-1]; }
+
+  iterator begin() const { return iterator(this, 0); }
+
+  iterator end() const { return iterator(this, size()); }
+
+  mrb_state* mrb() const { return m_mrb; }
+
+  mrb_value value() const { return m_array; }
+
+  private:
+
+  mrb_state* m_mrb;
+  mrb_value  m_array;
+};
+
+/// Checks if a type is an array_view
+template<typename T>
+struct is_array_view : std::false_type {};
+
+template<typename T>
+struct is_array_view<array_view<T>> : std::true_type {};
+
+namespace detail {
+
+/// Arrays are accepted by array_view parameters without checking
+/// their elements, which are checked when accessed.
+template<typename View>
+struct type_binder<View, std::enable_if_t<is_array_view<std::decay_t<View>>::value>> {
+
+  static constexpr bool borrowed = true;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const View& view) {
+    return view.value();
+  }
+
+  static auto mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return std::decay_t<View>(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_array_p(val);
+  }
+
+};
+
+} // namespace detail
+
+}
+
+#endif
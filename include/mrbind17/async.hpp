@@ -0,0 +1,295 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_ASYNC_H_
+#define MRBIND17_ASYNC_H_
+
+#include <mrbind17/type_binder.hpp>
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <mruby/variable.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace mrbind17 {
+
+/**
+ * @brief Fixed set of worker threads running the bodies of functions
+ * bound with async_offload. Unlike the executor's workers, these
+ * threads have no interpreter: they only run C++ code.
+ *
+ * The pool must outlive the interpreters whose functions use it.
+ */
+class thread_pool {
+
+  public:
+
+  explicit thread_pool(unsigned num_threads = std::thread::hardware_concurrency()) {
+    if(num_threads == 0) num_threads = 1;
+    m_workers.reserve(num_threads);
+    for(unsigned i = 0; i < num_threads; i++)
+      m_workers.emplace_back([this]() { run(); });
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool(thread_pool&&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+  thread_pool& operator=(thread_pool&&) = delete;
+
+  /**
+   * @brief The destructor completes pending tasks then joins
+   * the worker threads.
+   */
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    for(auto& worker : m_workers) worker.join();
+  }
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back(std::move(task));
+    }
+    m_cv.notify_one();
+  }
+
+  size_t size() const {
+    return m_workers.size();
+  }
+
+  private:
+
+  void run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true) {
+      m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+      if(m_tasks.empty()) break;
+      auto task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::vector<std::thread>          m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex                        m_mutex;
+  std::condition_variable           m_cv;
+  bool                              m_stop = false;
+};
+
+/**
+ * @brief Descriptor passed to def_function to run the function on a
+ * thread pool. Calling the method converts the arguments, schedules
+ * the function and immediately returns a Future; the result is
+ * converted when the script asks for it with Future#value, or for
+ * several futures at once with Future.wait_all.
+ *
+ * The function must be thread-safe and cannot take a block or
+ * non-const references. Its arguments are copied into the task, so
+ * they must own their data: arguments borrowing from Ruby objects
+ * (const char*, string_view, views, object, mrb_value, pointers to
+ * bound instances) are rejected at compile time.
+ */
+struct async_offload {
+
+  explicit async_offload(thread_pool& pool)
+  : pool(&pool) {}
+
+  thread_pool* pool;
+};
+
+namespace detail {
+
+/// Result of a function running on a thread pool. The C++ result is
+/// converted on the interpreter's thread when collected; an exception
+/// thrown by the function is rethrown by every attempt to collect it.
+class abstract_future {
+
+  public:
+
+  virtual ~abstract_future() = default;
+
+  bool ready() const {
+    return m_collected || is_ready();
+  }
+
+  void wait() const {
+    if(!m_collected) do_wait();
+  }
+
+  mrb_value collect(mrb_state* mrb) {
+    if(m_error) std::rethrow_exception(m_error);
+    m_collected = true;
+    try {
+      return do_collect(mrb);
+    } catch(...) {
+      m_error = std::current_exception();
+      throw;
+    }
+  }
+
+  private:
+
+  virtual bool is_ready() const = 0;
+  virtual void do_wait() const = 0;
+  virtual mrb_value do_collect(mrb_state* mrb) = 0;
+
+  bool               m_collected = false;
+  std::exception_ptr m_error;
+};
+
+template<typename R>
+class future_impl : public abstract_future {
+
+  public:
+
+  explicit future_impl(std::future<R>&& f)
+  : m_future(std::move(f)) {}
+
+  private:
+
+  bool is_ready() const override {
+    return m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  void do_wait() const override {
+    m_future.wait();
+  }
+
+  mrb_value do_collect(mrb_state* mrb) override {
+    if constexpr (std::is_void<R>::value) {
+      m_future.get();
+      return mrb_nil_value();
+    } else {
+      return cpp_to_mrb<R>(mrb, m_future.get());
+    }
+  }
+
+  std::future<R> m_future;
+};
+
+/// The task may still be running when its Future is collected by the
+/// GC or the interpreter is closed, so the finalizer waits for it.
+inline void delete_future(mrb_state*, void* p) {
+  auto f = static_cast<abstract_future*>(p);
+  f->wait();
+  delete f;
+}
+
+inline const mrb_data_type future_datatype = { "cpp_future", delete_future };
+
+/// Returns the future wrapped in a Future object, raising a TypeError
+/// if val is not an initialized Future.
+inline abstract_future* get_future(mrb_state* mrb, mrb_value val) {
+  auto f = static_cast<abstract_future*>(mrb_data_check_get_ptr(mrb, val, &future_datatype));
+  if(!f) mrb_raisef(mrb, E_TYPE_ERROR, "%S is not a Future", mrb_inspect(mrb, val));
+  return f;
+}
+
+inline mrb_value future_value(mrb_state* mrb, mrb_value self) {
+  mrb_sym value_sym = mrb_intern_lit(mrb, "@value");
+  if(mrb_iv_defined(mrb, self, value_sym)) return mrb_iv_get(mrb, self, value_sym);
+  mrb_value result = get_future(mrb, self)->collect(mrb);
+  mrb_iv_set(mrb, self, value_sym, result);
+  return result;
+}
+
+inline mrb_value future_ready(mrb_state* mrb, mrb_value self) {
+  return mrb_bool_value(get_future(mrb, self)->ready());
+}
+
+inline mrb_value future_wait(mrb_state* mrb, mrb_value self) {
+  get_future(mrb, self)->wait();
+  return self;
+}
+
+/// Future.wait_all(futures) or Future.wait_all(f1, f2, ...): waits for
+/// all the futures, then returns the array of their values.
+inline mrb_value future_wait_all(mrb_state* mrb, mrb_value self) {
+  mrb_value* argv;
+  mrb_int argc;
+  mrb_get_args(mrb, "*", &argv, &argc);
+  // the futures are read from the array at each step, and the array is
+  // kept in a local, since raising a TypeError runs Ruby code (inspect)
+  mrb_value futures = argc == 1 && mrb_array_p(argv[0])
+                    ? argv[0] : mrb_ary_new_from_values(mrb, argc, argv);
+  for(mrb_int i = 0; i < RARRAY_LEN(futures); i++)
+    get_future(mrb, mrb_ary_ref(mrb, futures, i))->wait();
+  mrb_value result = mrb_ary_new_capa(mrb, RARRAY_LEN(futures));
+  for(mrb_int i = 0; i < RARRAY_LEN(futures); i++)
+    mrb_ary_push(mrb, result, future_value(mrb, mrb_ary_ref(mrb, futures, i)));
+  return result;
+}
+
+/// Returns the Future class, defining it the first time.
+inline struct RClass* get_future_class(mrb_state* mrb) {
+  auto s = get_state(mrb);
+  if(!s) throw std::runtime_error("Futures require a state created by an interpreter");
+  if(s->future_class) return s->future_class;
+  struct RClass* cls = mrb_define_class(mrb, "Future", mrb->object_class);
+  MRB_SET_INSTANCE_TT(cls, MRB_TT_DATA);
+  mrb_define_method(mrb, cls, "value", future_value, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "ready?", future_ready, MRB_ARGS_NONE());
+  mrb_define_method(mrb, cls, "wait", future_wait, MRB_ARGS_NONE());
+  mrb_define_class_method(mrb, cls, "wait_all", future_wait_all, MRB_ARGS_ANY());
+  // futures are only created by offloaded functions
+  mrb_undef_class_method(mrb, cls, "new");
+  mrb_gc_register(mrb, mrb_obj_value(cls));
+  s->future_class = cls;
+  return cls;
+}
+
+/// Wraps a future into a Ruby Future object.
+inline mrb_value make_future(mrb_state* mrb, std::unique_ptr<abstract_future> f) {
+  struct RClass* cls = get_future_class(mrb);
+  auto data = Data_Wrap_Struct(mrb, cls, &future_datatype, f.get());
+  f.release();
+  return mrb_obj_value(data);
+}
+
+/// Returns the pool of the async_offload descriptor among extra,
+/// or nullptr if there is none.
+inline thread_pool* offload_pool(const async_offload& a) {
+  return a.pool;
+}
+
+template<typename Extra>
+thread_pool* offload_pool(const Extra&) {
+  return nullptr;
+}
+
+template<typename ... Extra>
+thread_pool* find_offload_pool(const Extra&... extra) {
+  thread_pool* pool = nullptr;
+  ((pool = offload_pool(extra) ? offload_pool(extra) : pool), ...);
+  return pool;
+}
+
+template<typename ... Extra>
+constexpr bool has_async_offload = (std::is_same<Extra, async_offload>::value || ...);
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_AUTOLOAD_H_
+#define MRBIND17_AUTOLOAD_H_
+
+#include <mrbind17/block.hpp>
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <mruby/class.h>
+#include <mruby/compile.h>
+#include <mruby/error.h>
+#include <mruby/irep.h>
+#include <mruby/proc.h>
+#include <mruby/string.h>
+#include <mruby/variable.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Compiles the script of an autoload entry into a proc, without
+/// running it. Returns nil and sets exc if it cannot be compiled.
+inline mrb_value compile_autoload_entry(mrb_state* mrb, const autoload_entry& entry, mrb_value& exc) {
+  std::string code;
+  if(entry.type == autoload_entry::kind::file) {
+    std::ifstream file(entry.source, std::ios::binary);
+    if(!file) {
+      exc = mrb_exc_new_str(mrb, E_RUNTIME_ERROR,
+                            mrb_str_new_cstr(mrb, ("Could not open autoloaded file " + entry.source).c_str()));
+      return mrb_nil_value();
+    }
+    code.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  mrbc_context* cxt = mrbc_context_new(mrb);
+  cxt->no_exec = TRUE;
+  mrb_value proc;
+  if(entry.type == autoload_entry::kind::bytecode) {
+    proc = mrb_load_irep_buf_cxt(mrb, entry.data, entry.size, cxt);
+  } else if(entry.type == autoload_entry::kind::file && code.compare(0, 4, "RITE") == 0) {
+    // files produced by mrbc start with the RITE signature
+    proc = mrb_load_irep_buf_cxt(mrb, code.data(), code.size(), cxt);
+  } else {
+    const std::string& text = entry.type == autoload_entry::kind::file ? code : entry.source;
+    if(entry.type == autoload_entry::kind::file) mrbc_filename(mrb, cxt, entry.source.c_str());
+    proc = mrb_load_nstring_cxt(mrb, text.data(), text.size(), cxt);
+  }
+  mrbc_context_free(mrb, cxt);
+  if(mrb->exc) {
+    exc = mrb_obj_value(mrb->exc);
+    mrb->exc = nullptr;
+    return mrb_nil_value();
+  }
+  if(!mrb_proc_p(proc)) {
+    exc = mrb_exc_new_str(mrb, E_SCRIPT_ERROR,
+                          mrb_str_new_cstr(mrb, "Could not compile autoloaded library"));
+    return mrb_nil_value();
+  }
+  return proc;
+}
+
+/// C function running the library stored in its environment with the
+/// top-level object as self and Object as target class, as
+/// interpreter::run does for scripts.
+inline mrb_value run_autoload_library(mrb_state* mrb, mrb_value) {
+  mrb_value library = mrb_proc_cfunc_env_get(mrb, 0);
+  return mrb_yield_with_class(mrb, library, 0, nullptr, mrb_top_self(mrb), mrb->object_class);
+}
+
+/// Runs the library of an autoload entry at top level. The library is
+/// compiled without being run (so its target class is set here), then
+/// run by a C proc called with protected_call: an exception raised by
+/// the library is caught by the mrb_funcall of protected_call and
+/// returned in exc, instead of unwinding the C++ frames of the
+/// const_missing hook. Returns false if the library failed.
+inline bool load_autoload_entry(mrb_state* mrb, const autoload_entry& entry, mrb_value& exc) {
+  int ai = mrb_gc_arena_save(mrb);
+  mrb_value proc = compile_autoload_entry(mrb, entry, exc);
+  if(mrb_nil_p(proc)) {
+    mrb_gc_arena_restore(mrb, ai);
+    mrb_gc_protect(mrb, exc);
+    return false;
+  }
+  MRB_PROC_SET_TARGET_CLASS(mrb_proc_ptr(proc), mrb->object_class);
+  struct RProc* runner = mrb_proc_new_cfunc_with_env(mrb, run_autoload_library, 1, &proc);
+  mrb_value result;
+  exc = protected_call(mrb, mrb_obj_value(runner), 0, nullptr, result);
+  mrb_gc_arena_restore(mrb, ai);
+  if(mrb_nil_p(exc)) return true;
+  mrb_gc_protect(mrb, exc);
+  return false;
+}
+
+/// Looks for an autoload entry defining the constant sym referenced from
+/// mod, trying mod then its enclosing modules up to the top level, as
+/// constant lookup does. Returns the module the constant was loaded in,
+/// or nullptr if no entry was loaded. A Ruby exception raised by the
+/// script is returned in exc, and the entry can be loaded again by a
+/// later reference.
+inline struct RClass* try_autoload(mrb_state* mrb, struct RClass* mod, mrb_sym sym, mrb_value& exc) {
+  auto s = get_state(mrb);
+  if(!s || s->autoloads.empty()) return nullptr;
+  mrb_int len = 0;
+  const char* name = mrb_sym2name_len(mrb, sym, &len);
+  struct RClass* c = mod;
+  while(true) {
+    // anonymous modules have no outer module, the top level is tried last
+    if(!c) c = mrb->object_class;
+    std::string key;
+    if(c != mrb->object_class) {
+      const char* path = mrb_class_name(mrb, c);
+      if(!path) {
+        c = mrb_class_outer_module(mrb, c);
+        continue;
+      }
+      key = std::string(path) + "::";
+    }
+    key.append(name, len);
+    auto it = s->autoloads.find(key);
+    if(it != s->autoloads.end() && !it->second.loaded) {
+      auto& entry = it->second;
+      // marked first, so that the library referencing its own
+      // constant before defining it does not load it again
+      entry.loaded = true;
+      if(!load_autoload_entry(mrb, entry, exc)) {
+        entry.loaded = false;
+        return nullptr;
+      }
+      s->autoloaded.push_back(std::move(key));
+      return c;
+    }
+    if(c == mrb->object_class) break;
+    c = mrb_class_outer_module(mrb, c);
+  }
+  return nullptr;
+}
+
+/// Module#const_missing, loading the library registered for the missing
+/// constant if any, and otherwise calling the original const_missing.
+inline mrb_value autoload_const_missing(mrb_state* mrb, mrb_value mod) {
+  mrb_sym sym;
+  mrb_get_args(mrb, "n", &sym);
+  mrb_value exc = mrb_nil_value();
+  struct RClass* c = try_autoload(mrb, mrb_class_ptr(mod), sym, exc);
+  if(!mrb_nil_p(exc)) mrb_exc_raise(mrb, exc);
+  if(c && mrb_const_defined_at(mrb, mrb_obj_value(c), sym))
+    return mrb_const_get(mrb, mrb_obj_value(c), sym);
+  mrb_value arg = mrb_symbol_value(sym);
+  return mrb_funcall_argv(mrb, mod, mrb_intern_lit(mrb, "__mrbind17_const_missing"), 1, &arg);
+}
+
+/// Installs the autoloading const_missing, keeping the original one
+/// under another name. Installing it again (e.g. after interpreter::reset
+/// removed it) is harmless.
+inline void install_autoload_hook(mrb_state* mrb) {
+  struct RClass* mod = mrb->module_class;
+  if(!mrb_obj_respond_to(mrb, mod, mrb_intern_lit(mrb, "__mrbind17_const_missing")))
+    mrb_define_alias(mrb, mod, "__mrbind17_const_missing", "const_missing");
+  mrb_define_method(mrb, mod, "const_missing", autoload_const_missing, MRB_ARGS_REQ(1));
+}
+
+inline void add_autoload(mrb_state* mrb, const std::string& name, autoload_entry entry) {
+  auto s = get_state(mrb);
+  if(!s) throw std::runtime_error("Autoloading requires a state created by an interpreter");
+  s->autoloads[name] = std::move(entry);
+  install_autoload_hook(mrb);
+}
+
+/// Remembers which libraries were loaded when a checkpoint is taken.
+inline void autoload_checkpoint(mrb_state* mrb) {
+  auto s = get_state(mrb);
+  if(s) s->autoloaded_at_checkpoint = s->autoloaded.size();
+}
+
+/// After the interpreter is reset, the constants defined by libraries
+/// loaded since the checkpoint are gone, so these libraries are marked
+/// as not loaded, and the hook is installed again in case it was
+/// defined after the checkpoint.
+inline void autoload_reset(mrb_state* mrb) {
+  auto s = get_state(mrb);
+  if(!s || s->autoloads.empty()) return;
+  for(size_t i = s->autoloaded_at_checkpoint; i < s->autoloaded.size(); i++) {
+    auto it = s->autoloads.find(s->autoloaded[i]);
+    if(it != s->autoloads.end()) it->second.loaded = false;
+  }
+  s->autoloaded.resize(std::min(s->autoloaded.size(), s->autoloaded_at_checkpoint));
+  install_autoload_hook(mrb);
+}
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_BLOCK_H_
+#define MRBIND17_BLOCK_H_
+
+#include <mrbind17/type_binder.hpp>
+#include <mruby.h>
+#include <mruby/error.h>
+#include <mruby/string.h>
+#include <tuple>
+#include <type_traits>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Thrown out of a bound function when a Ruby exception was raised by a
+/// block it called, so that the C++ frames of the function are unwound
+/// before the exception is raised again in the VM by function_caller.
+class ruby_exception {
+
+  public:
+
+  explicit ruby_exception(mrb_value exc)
+  : m_exc(exc) {}
+
+  mrb_value value() const {
+    return m_exc;
+  }
+
+  private:
+
+  mrb_value m_exc;
+};
+
+/// Calls a proc, returning the exception it raised (or nil). Clearing
+/// mrb->jmp makes mrb_funcall catch the exception and unwind the VM
+/// frames, as it does when called from outside the VM.
+inline mrb_value protected_call(mrb_state* mrb, mrb_value proc, mrb_int argc,
+                                const mrb_value* argv, mrb_value& result) {
+  auto jmp = mrb->jmp;
+  mrb->jmp = nullptr;
+  result = mrb_funcall_argv(mrb, proc, mrb_intern_lit(mrb, "call"), argc, argv);
+  mrb->jmp = jmp;
+  if(!mrb->exc) return mrb_nil_value();
+  mrb_value exc = mrb_obj_value(mrb->exc);
+  mrb->exc = nullptr;
+  return exc;
+}
+
+} // namespace detail
+
+/**
+ * @brief A bound function taking a block as its last parameter receives
+ * the block passed to it in Ruby (or an empty block if none was given),
+ * and can call it any number of times, e.g. to stream the results of a
+ * scan one at a time instead of building an Array:
+ *
+ * @code
+ * mruby.def_function("each_line", [](const std::string& path, mrbind17::block blk) {
+ *   std::ifstream f(path);
+ *   for(std::string line; std::getline(f, line);) blk.yield(line);
+ * });
+ * @endcode
+ *
+ * The arguments are converted and the block's result is dropped at each
+ * call, so that memory use does not grow with the number of calls.
+ * If the block raises an exception, yield throws a C++ exception that
+ * unwinds the function before the Ruby exception is propagated to the
+ * caller of the function; it must not be caught by the function.
+ * Exiting the block with break goes the same way: the VM hands the
+ * break back to protected_call, the function is unwound, and the
+ * method call evaluates to the value given to break, so a script can
+ * stop a scan early. Functions taking a block cannot be memoized.
+ */
+class block {
+
+  public:
+
+  block(mrb_state* mrb, mrb_value proc)
+  : m_mrb(mrb)
+  , m_proc(proc) {}
+
+  /**
+   * @brief Checks whether a block was given.
+   */
+  explicit operator bool() const {
+    return !mrb_nil_p(m_proc);
+  }
+
+  /**
+   * @brief Calls the block with the given arguments, returning
+   * its result converted into R (nothing if R is void).
+   */
+  template<typename R = void, typename ... Args>
+  R yield(Args&&... args) const {
+    if(mrb_nil_p(m_proc)) throw_exception("LocalJumpError", "no block given (yield)");
+    int ai = mrb_gc_arena_save(m_mrb);
+    mrb_value argv[sizeof...(Args) + 1] = {
+      detail::cpp_to_mrb<std::decay_t<Args>>(m_mrb, std::forward<Args>(args))...
+    };
+    mrb_value result;
+    mrb_value exc = detail::protected_call(m_mrb, m_proc, sizeof...(Args), argv, result);
+    if(!mrb_nil_p(exc)) {
+      mrb_gc_arena_restore(m_mrb, ai);
+      mrb_gc_protect(m_mrb, exc);
+      throw detail::ruby_exception(exc);
+    }
+    if constexpr (std::is_void<R>::value) {
+      mrb_gc_arena_restore(m_mrb, ai);
+    } else {
+      if(!detail::check_type<R>(m_mrb, result)) {
+        mrb_gc_arena_restore(m_mrb, ai);
+        throw_exception("TypeError", "unexpected type returned by block");
+      }
+      R value = detail::mrb_to_cpp<R>(m_mrb, result);
+      mrb_gc_arena_restore(m_mrb, ai);
+      return value;
+    }
+  }
+
+  mrb_value value() const {
+    return m_proc;
+  }
+
+  private:
+
+  [[noreturn]] void throw_exception(const char* cls, const char* msg) const {
+    mrb_value exc = mrb_exc_new_str(m_mrb, mrb_exc_get(m_mrb, cls), mrb_str_new_cstr(m_mrb, msg));
+    mrb_gc_protect(m_mrb, exc);
+    throw detail::ruby_exception(exc);
+  }
+
+  mrb_state* m_mrb;
+  mrb_value  m_proc;
+};
+
+namespace detail {
+
+/// Checks if the last parameter of a signature is a block
+template<typename ... P>
+struct ends_with_block : std::false_type {};
+
+template<typename First, typename ... Rest>
+struct ends_with_block<First, Rest...>
+: std::is_same<block, std::decay_t<std::tuple_element_t<sizeof...(Rest), std::tuple<First, Rest...>>>> {};
+
+template<typename ... P>
+inline constexpr size_t count_blocks = (size_t(0) + ... + (std::is_same<block, std::decay_t<P>>::value ? 1 : 0));
+
+/// Returns the block passed to the C function being executed, or nil
+inline mrb_value current_block(mrb_state* mrb) {
+  mrb_value* argv = nullptr;
+  mrb_int    argc = 0;
+  mrb_value  blk  = mrb_nil_value();
+  mrb_get_args(mrb, "*!&", &argv, &argc, &blk);
+  return blk;
+}
+
+template<typename Block>
+struct type_binder<Block, std::enable_if_t<std::is_same<std::decay_t<Block>, block>::value>> {
+
+  static constexpr bool borrowed = true;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const block& blk) {
+    return blk.value();
+  }
+
+  static block mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return block(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_nil_p(val) || mrb_proc_p(val);
+  }
+
+};
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_BYTE_BUFFER_H_
+#define MRBIND17_BYTE_BUFFER_H_
+
+#include <mrbind17/type_binder.hpp>
+#include <mruby.h>
+#include <mruby/string.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+
+namespace mrbind17 {
+
+/**
+ * @brief A byte_buffer is a growable array of bytes whose storage can be
+ * handed over to a Ruby String without copying. A bound function
+ * returning a byte_buffer produces a String that takes ownership of
+ * the buffer. A bound function taking a byte_buffer parameter receives
+ * a copy of the String; to take the bytes of the String without copying
+ * them, the function takes a string_handle and calls its take method.
+ *
+ * Ownership is transferred only if the interpreter uses MRuby's default
+ * allocator (the buffer is allocated with malloc), and on the way back
+ * only if the String owns its bytes exclusively (not frozen, shared,
+ * embedded or static). The bytes are copied otherwise.
+ *
+ * The bytes are always followed by a null character, not included
+ * in the size, as MRuby expects.
+ */
+class byte_buffer {
+
+  public:
+
+  byte_buffer() = default;
+
+  /**
+   * @brief Creates a buffer of the given size. The bytes are not initialized.
+   */
+  explicit byte_buffer(size_t size) {
+    resize(size);
+  }
+
+  byte_buffer(const void* data, size_t size) {
+    append(data, size);
+  }
+
+  byte_buffer(const byte_buffer&) = delete;
+  byte_buffer& operator=(const byte_buffer&) = delete;
+
+  byte_buffer(byte_buffer&& other)
+  : m_data(other.m_data)
+  , m_size(other.m_size)
+  , m_capacity(other.m_capacity) {
+    other.m_data = nullptr;
+    other.m_size = other.m_capacity = 0;
+  }
+
+  byte_buffer& operator=(byte_buffer&& other) {
+    if(this == &other) return *this;
+    std::free(m_data);
+    m_data     = other.m_data;
+    m_size     = other.m_size;
+    m_capacity = other.m_capacity;
+    other.m_data = nullptr;
+    other.m_size = other.m_capacity = 0;
+    return *this;
+  }
+
+  ~byte_buffer() {
+    std::free(m_data);
+  }
+
+  char* data() { return m_data; }
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_capacity; }
+  bool empty() const { return m_size == 0; }
+
+  std::string_view view() const {
+    return std::string_view(m_data, m_size);
+  }
+
+  /**
+   * @brief Ensures that the buffer can hold capacity bytes without
+   * being reallocated.
+   */
+  void reserve(size_t capacity) {
+    if(capacity <= m_capacity && m_data) return;
+    auto data = static_cast<char*>(std::realloc(m_data, capacity + 1));
+    if(!data) throw std::bad_alloc();
+    m_data     = data;
+    m_capacity = capacity;
+    m_data[m_size] = '\0';
+  }
+
+  /**
+   * @brief Changes the size of the buffer. New bytes are not initialized.
+   */
+  void resize(size_t size) {
+    if(size > m_capacity || !m_data)
+      reserve(size > m_capacity ? std::max(size, 2*m_capacity) : size);
+    m_size = size;
+    m_data[m_size] = '\0';
+  }
+
+  void append(const void* data, size_t size) {
+    size_t offset = m_size;
+    resize(m_size + size);
+    if(size) std::memcpy(m_data + offset, data, size);
+  }
+
+  void clear() {
+    resize(0);
+  }
+
+  private:
+
+  friend struct detail::type_binder<byte_buffer>;
+  friend class string_handle;
+
+  // Takes ownership of memory allocated with malloc, holding
+  // capacity+1 bytes and null-terminated at size
+  void adopt(char* data, size_t size, size_t capacity) {
+    std::free(m_data);
+    m_data     = data;
+    m_size     = size;
+    m_capacity = capacity;
+  }
+
+  char* release() {
+    char* data = m_data;
+    m_data = nullptr;
+    m_size = m_capacity = 0;
+    return data;
+  }
+
+  char*  m_data     = nullptr;
+  size_t m_size     = 0;
+  size_t m_capacity = 0;
+};
+
+namespace detail {
+
+/// Checks if memory obtained from malloc can be freed by the
+/// allocator of an MRuby state, and vice versa.
+inline bool uses_malloc_allocator(mrb_state* mrb) {
+  return mrb->allocf == mrb_default_allocf;
+}
+
+} // namespace detail
+
+/**
+ * @brief A string_handle is a bound function parameter referring to the
+ * Ruby String it is passed, valid for the duration of the call. Calling
+ * take moves the bytes of the String into a byte_buffer, leaving the
+ * String empty; converting the arguments never modifies the String, so
+ * it is left untouched if the call fails before the function runs.
+ */
+class string_handle {
+
+  public:
+
+  string_handle(mrb_state* mrb, mrb_value val)
+  : m_mrb(mrb)
+  , m_value(val) {}
+
+  mrb_value value() const {
+    return m_value;
+  }
+
+  std::string_view view() const {
+    return std::string_view(RSTRING_PTR(m_value), RSTRING_LEN(m_value));
+  }
+
+  /**
+   * @brief Takes the bytes of the String without copying them if the
+   * String owns them exclusively, or copies them otherwise.
+   */
+  byte_buffer take() {
+    byte_buffer buffer;
+    struct RString* s = mrb_str_ptr(m_value);
+    if(detail::uses_malloc_allocator(m_mrb) && !MRB_FROZEN_P(s) && !RSTR_EMBED_P(s)
+    && !RSTR_SHARED_P(s) && !RSTR_FSHARED_P(s) && !RSTR_NOFREE_P(s) && !RSTR_POOL_P(s)) {
+      buffer.adopt(s->as.heap.ptr, s->as.heap.len, s->as.heap.aux.capa);
+      RSTR_SET_EMBED_FLAG(s);
+      RSTR_SET_EMBED_LEN(s, 0);
+      s->as.ary[0] = '\0';
+    } else {
+      buffer.append(RSTRING_PTR(m_value), RSTRING_LEN(m_value));
+    }
+    return buffer;
+  }
+
+  private:
+
+  mrb_state* m_mrb;
+  mrb_value  m_value;
+};
+
+namespace detail {
+
+template<typename Buffer>
+struct type_binder<Buffer, std::enable_if_t<std::is_same<std::decay_t<Buffer>, byte_buffer>::value>> {
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, byte_buffer buffer) {
+    if(buffer.empty() || !uses_malloc_allocator(mrb)) {
+      int ai = mrb_gc_arena_save(mrb);
+      auto val = mrb_str_new(mrb, buffer.data(), buffer.size());
+      mrb_gc_arena_restore(mrb, ai);
+      return val;
+    }
+    int ai = mrb_gc_arena_save(mrb);
+    auto s = reinterpret_cast<struct RString*>(mrb_obj_alloc(mrb, MRB_TT_STRING, mrb->string_class));
+    mrb_gc_arena_restore(mrb, ai);
+    s->as.heap.len      = static_cast<mrb_int>(buffer.size());
+    s->as.heap.aux.capa = static_cast<mrb_int>(buffer.capacity());
+    s->as.heap.ptr      = buffer.release();
+    return mrb_obj_value(s);
+  }
+
+  static byte_buffer mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return byte_buffer(RSTRING_PTR(val), RSTRING_LEN(val));
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_string_p(val);
+  }
+
+};
+
+template<typename Handle>
+struct type_binder<Handle, std::enable_if_t<std::is_same<std::decay_t<Handle>, string_handle>::value>> {
+
+  static constexpr bool borrowed = true;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const string_handle& handle) {
+    return handle.value();
+  }
+
+  static string_handle mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return string_handle(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_string_p(val);
+  }
+
+};
+
+} // namespace detail
+
+}
+
+#endif
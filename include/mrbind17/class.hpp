@@ -0,0 +1,154 @@
+/*
+   Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+   All rights reserved. Use of this source code is governed by a
+   BSD-style license that can be found in the LICENSE file.
+ */
+#ifndef MRBIND17_CLASS_H_
+#define MRBIND17_CLASS_H_
+
+#include <mrbind17/module.hpp>
+#include <mrbind17/instance.hpp>
+#include <mrbind17/type_binder.hpp>
+#include <mrbind17/mruby_util.hpp>
+#include <mruby.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <mruby/proc.h>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Computes the offset of a data member within its class.
+/// The address is only computed, the storage is never accessed.
+template<typename T, typename Field>
+mrb_int member_offset(Field T::*member) {
+    alignas(T) static char storage[sizeof(T)];
+    auto obj = reinterpret_cast<const T*>(storage);
+    return reinterpret_cast<const char*>(&(obj->*member)) - storage;
+}
+
+/// Returns a reference to the field located at the offset stored in
+/// the environment of the current method
+template<typename T, typename Field>
+Field& field_at_env_offset(mrb_state* mrb, mrb_value self) {
+    T* obj = get_instance<T>(mrb, self);
+    if(!obj) {
+        auto type_name = get_cpp_class_name<T>(mrb);
+        mrb_raisef(mrb, E_TYPE_ERROR, "%S is not an initialized %S",
+                   mrb_obj_value(mrb_obj_class(mrb, self)),
+                   mrb_str_new_cstr(mrb, type_name.c_str()));
+    }
+    mrb_int offset = mrb_fixnum(mrb_proc_cfunc_env_get(mrb, 0));
+    return *reinterpret_cast<Field*>(reinterpret_cast<char*>(obj) + offset);
+}
+
+template<typename T, typename Field>
+mrb_value field_getter(mrb_state* mrb, mrb_value self) {
+    return type_binder<Field>::cpp_to_mrb(mrb, field_at_env_offset<T, Field>(mrb, self));
+}
+
+template<typename T, typename Field>
+mrb_value field_setter(mrb_state* mrb, mrb_value self) {
+    mrb_value val;
+    mrb_get_args(mrb, "o", &val);
+    if(!type_binder<Field>::check_type(mrb, val)) {
+        auto type_name = get_cpp_class_name<Field>(mrb);
+        raise_invalid_type(mrb, 0, type_name.c_str(), val);
+    }
+    field_at_env_offset<T, Field>(mrb, self) = type_binder<Field>::mrb_to_cpp(mrb, val);
+    return val;
+}
+
+/// Initializer of bound classes, creating a default-constructed instance
+template<typename T>
+mrb_value default_initialize(mrb_state* mrb, mrb_value self) {
+    auto inst = new instance<T>{ new T(), true };
+    auto previous = DATA_PTR(self);
+    mrb_data_init(self, inst, &instance_type<T>::datatype);
+    if(previous) delete_instance<T>(mrb, previous);
+    return self;
+}
+
+} // namespace detail
+
+/**
+ * @brief The class_ object represents a Ruby class bound to the C++
+ * type T. Instances of the class are Ruby objects wrapping a T.
+ *
+ * @tparam T C++ type.
+ */
+template<typename T>
+class class_ : public module {
+
+    friend class module;
+
+    public:
+
+    /**
+     * @brief Exposes a data member as a read/write attribute.
+     * The generated getter and setter access the field directly
+     * at its offset in the instance and convert it with its
+     * type_binder, without going through std::function.
+     *
+     * @tparam Field Type of the field.
+     * @param name Name of the attribute.
+     * @param member Pointer to the data member.
+     *
+     * @return A reference to the current class.
+     */
+    template<typename Field>
+    class_& def_readwrite(const char* name, Field T::*member) {
+        def_readonly(name, member);
+        mrb_value env[] = { mrb_fixnum_value(detail::member_offset(member)) };
+        std::string setter_name = std::string(name) + "=";
+        detail::define_method_with_env(m_mrb, m_module, setter_name.c_str(),
+            &detail::field_setter<T, Field>, 1, env);
+        return *this;
+    }
+
+    /**
+     * @brief Exposes a data member as a read-only attribute.
+     *
+     * @tparam Field Type of the field.
+     * @param name Name of the attribute.
+     * @param member Pointer to the data member.
+     *
+     * @return A reference to the current class.
+     */
+    template<typename Field>
+    class_& def_readonly(const char* name, Field T::*member) {
+        static_assert(!std::is_function<Field>::value,
+                      "def_readonly/def_readwrite expect a pointer to a data member");
+        mrb_value env[] = { mrb_fixnum_value(detail::member_offset(member)) };
+        detail::define_method_with_env(m_mrb, m_module, name,
+            &detail::field_getter<T, Field>, 1, env);
+        return *this;
+    }
+
+    private:
+
+    class_(mrb_state* mrb, struct RClass* cls, const char* name)
+    : module(mrb, cls, name) {
+        MRB_SET_INSTANCE_TT(cls, MRB_TT_DATA);
+        detail::register_cpp_class<T>(mrb, cls);
+        detail::register_cpp_class_name<T>(mrb, name);
+        if constexpr (std::is_default_constructible<T>::value) {
+            mrb_define_method(mrb, cls, "initialize",
+                &detail::default_initialize<T>, MRB_ARGS_NONE());
+        }
+    }
+};
+
+template<typename T>
+class_<T> module::def_class(const char* name) {
+    auto cls = mrb_define_class_under(m_mrb, m_module, name, m_mrb->object_class);
+    return class_<T>(m_mrb, cls, name);
+}
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_COMMON_SIGNATURES_H_
+#define MRBIND17_COMMON_SIGNATURES_H_
+
+#include <mrbind17/mrbind17.hpp>
+#include <string>
+
+// Opt-in header reducing the compilation time of translation units that
+// bind many functions. Including it declares the function wrappers of the
+// most common signatures as explicitly instantiated elsewhere, so that
+// translation units do not instantiate them again. Exactly one translation
+// unit of the program must define MRBIND17_INSTANTIATE_COMMON_SIGNATURES
+// before including this header, to provide the instantiations.
+
+#ifdef MRBIND17_INSTANTIATE_COMMON_SIGNATURES
+#define MRBIND17_SIGNATURE(...) template class mrbind17::detail::function_impl<__VA_ARGS__>;
+#else
+#define MRBIND17_SIGNATURE(...) extern template class mrbind17::detail::function_impl<__VA_ARGS__>;
+#endif
+
+MRBIND17_SIGNATURE(void())
+MRBIND17_SIGNATURE(void(bool))
+MRBIND17_SIGNATURE(void(int))
+MRBIND17_SIGNATURE(void(double))
+MRBIND17_SIGNATURE(void(const std::string&))
+MRBIND17_SIGNATURE(void(int, int))
+MRBIND17_SIGNATURE(void(double, double))
+MRBIND17_SIGNATURE(bool())
+MRBIND17_SIGNATURE(bool(int))
+MRBIND17_SIGNATURE(bool(const std::string&))
+MRBIND17_SIGNATURE(int())
+MRBIND17_SIGNATURE(int(int))
+MRBIND17_SIGNATURE(int(int, int))
+MRBIND17_SIGNATURE(int(const std::string&))
+MRBIND17_SIGNATURE(double())
+MRBIND17_SIGNATURE(double(double))
+MRBIND17_SIGNATURE(double(double, double))
+MRBIND17_SIGNATURE(std::string())
+MRBIND17_SIGNATURE(std::string(const std::string&))
+MRBIND17_SIGNATURE(std::string(const std::string&, const std::string&))
+MRBIND17_SIGNATURE(mrbind17::object(mrbind17::object))
+
+#undef MRBIND17_SIGNATURE
+
+#endif
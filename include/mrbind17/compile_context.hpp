@@ -0,0 +1,148 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_COMPILE_CONTEXT_H_
+#define MRBIND17_COMPILE_CONTEXT_H_
+
+#include <mruby.h>
+#include <mruby/compile.h>
+#include <cstdio>
+#include <istream>
+#include <string>
+
+namespace mrbind17 {
+
+/**
+ * @brief A compile_context carries compilation state from one call to
+ * interpreter::execute to the next, like successive lines typed in an
+ * interactive shell: local variables defined at the top level of a
+ * script remain visible to the scripts executed later with the same
+ * context, and the file name given to the context appears in backtraces
+ * and syntax error messages.
+ *
+ * Local variables live in the top-level stack of the interpreter, so
+ * executing a script without this context (or with another one) in
+ * between may overwrite them.
+ *
+ * A compile_context must be destroyed before the interpreter it was
+ * created for.
+ */
+class compile_context {
+
+  public:
+
+  /**
+   * @brief Constructor.
+   *
+   * @param mrb MRuby state the context is used with.
+   * @param filename File name to report in backtraces (may be empty).
+   */
+  explicit compile_context(mrb_state* mrb, const std::string& filename = "")
+  : m_mrb(mrb)
+  , m_cxt(mrbc_context_new(mrb)) {
+    m_cxt->capture_errors = true;
+    if(!filename.empty()) set_filename(filename);
+  }
+
+  compile_context(const compile_context&) = delete;
+  compile_context& operator=(const compile_context&) = delete;
+
+  compile_context(compile_context&& other)
+  : m_mrb(other.m_mrb)
+  , m_cxt(other.m_cxt) {
+    other.m_cxt = nullptr;
+  }
+
+  compile_context& operator=(compile_context&& other) {
+    if(this == &other) return *this;
+    if(m_cxt) mrbc_context_free(m_mrb, m_cxt);
+    m_mrb = other.m_mrb;
+    m_cxt = other.m_cxt;
+    other.m_cxt = nullptr;
+    return *this;
+  }
+
+  ~compile_context() {
+    if(m_cxt) mrbc_context_free(m_mrb, m_cxt);
+  }
+
+  /**
+   * @brief Sets the file name reported in backtraces for the
+   * scripts compiled from now on.
+   */
+  void set_filename(const std::string& filename) {
+    mrbc_filename(m_mrb, m_cxt, filename.c_str());
+  }
+
+  std::string get_filename() const {
+    return m_cxt->filename ? m_cxt->filename : "";
+  }
+
+  /**
+   * @brief Sets the line number of the first line of the next script,
+   * e.g. when feeding a file to the interpreter in pieces.
+   */
+  void set_lineno(unsigned lineno) {
+    m_cxt->lineno = static_cast<uint16_t>(lineno);
+  }
+
+  /**
+   * @brief Returns the number of top-level local variables
+   * defined by the scripts compiled so far.
+   */
+  size_t num_locals() const {
+    return m_cxt->slen;
+  }
+
+  mrbc_context* get() const {
+    return m_cxt;
+  }
+
+  private:
+
+  mrb_state*    m_mrb;
+  mrbc_context* m_cxt;
+};
+
+namespace detail {
+
+/// Opens a read-only FILE* pulling its data from an input stream as the
+/// parser consumes it, so that a script can be compiled without holding
+/// it entirely in memory. Returns nullptr on platforms providing neither
+/// fopencookie nor funopen.
+#if defined(__GLIBC__)
+inline ssize_t istream_cookie_read(void* cookie, char* buf, size_t size) {
+  auto is = static_cast<std::istream*>(cookie);
+  is->read(buf, static_cast<std::streamsize>(size));
+  if(is->bad()) return -1;
+  return static_cast<ssize_t>(is->gcount());
+}
+
+inline FILE* open_istream(std::istream& is) {
+  cookie_io_functions_t functions = { istream_cookie_read, nullptr, nullptr, nullptr };
+  return fopencookie(&is, "r", functions);
+}
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+inline int istream_cookie_read(void* cookie, char* buf, int size) {
+  auto is = static_cast<std::istream*>(cookie);
+  is->read(buf, size);
+  if(is->bad()) return -1;
+  return static_cast<int>(is->gcount());
+}
+
+inline FILE* open_istream(std::istream& is) {
+  return funopen(&is, istream_cookie_read, nullptr, nullptr, nullptr);
+}
+#else
+inline FILE* open_istream(std::istream&) {
+  return nullptr;
+}
+#endif
+
+} // namespace detail
+
+}
+
+#endif
@@ -3,35 +3,38 @@
 
 #include <mrbind17/type_traits.hpp>
 #include <mrbind17/type_binder.hpp>
+#include <mrbind17/async.hpp>
+#include <mrbind17/block.hpp>
+#include <mrbind17/memoize.hpp>
+#include <mrbind17/state.hpp>
+#include <mrbind17/trace.hpp>
 #include <mruby.h>
+#include <mruby/class.h>
 #include <mruby/data.h>
-#include <vector>
+#include <mruby/proc.h>
 #include <functional>
-#include <iostream>
+#include <future>
+#include <memory>
+#include <string>
+#include <tuple>
 
 namespace mrbind17 {
 
 namespace detail {
 
-/// Helper structure that makes a function return the ruby nil
-/// value if the C function returns void
-template<typename Function>
-struct make_function_return_mrb_value {};
-
-template<typename ... P>
-struct make_function_return_mrb_value<std::function<void(P...)>> {
-  static mrb_value call(mrb_state*, const std::function<void(P...)>& f, P&&... params) {
-    f(std::forward<P>(params)...);
-    return mrb_nil_value();
-  }
-};
-
-template<typename R, typename ... P>
-struct make_function_return_mrb_value<std::function<R(P...)>> {
-  static mrb_value call(mrb_state* mrb, const std::function<R(P...)>& f, P&&... params) {
-    return cpp_to_mrb<R>(mrb, f(std::forward<P>(params)...) );
-  }
-};
+/// Builds the signature of a function from the type-erased
+/// descriptions of its parameters and the name of its return type.
+inline std::string build_signature(mrb_state* mrb,
+                                   const arg_type_info* const* params, size_t n,
+                                   std::string (*return_type_name)(mrb_state*)) {
+    std::string result = "(";
+    for(size_t i = 0; i < n; i++) {
+        if(i != 0) result += ", ";
+        result += params[i]->name(mrb);
+    }
+    result += ") -> " + return_type_name(mrb);
+    return result;
+}
 
 class abstract_function {
 
@@ -55,6 +58,14 @@ class abstract_function {
 
     virtual std::string signature(mrb_state* mrb) const = 0;
 
+    virtual unsigned arity() const = 0;
+
+    /// C function implementing the method bound to this function, or
+    /// nullptr to go through the generic function_caller.
+    virtual mrb_func_t caller() const {
+        return nullptr;
+    }
+
 };
 
 template<typename F>
@@ -67,53 +78,244 @@ class function_impl<R(P...)> : public abstract_function {
 
     template<typename ... Extra>
     function_impl(std::function<R(P...)>&& fun, const Extra&... extra)
-    : m_function(std::move(fun)) {}
+    : m_function(std::move(fun)) {
+        // the block is not part of the key, a cached result would be
+        // returned without calling it
+        static_assert(!(ends_with_block<P...>::value && has_memoize<Extra...>),
+                      "A function taking a block cannot be memoized");
+    }
     
     template<typename ... Extra>
     function_impl(const std::function<R(P...)>& fun, const Extra&... extra)
     : function_impl(std::function<R(P...)>(fun), extra...) {}
 
+    // A block parameter, which must come last, receives the block
+    // passed to the method instead of a positional argument
+    static constexpr bool     takes_block = ends_with_block<P...>::value;
+    static constexpr unsigned num_args    = sizeof...(P) - (takes_block ? 1 : 0);
+
+    static_assert(count_blocks<P...> == (takes_block ? 1 : 0),
+                  "A block parameter must be the last parameter of a function");
+
     mrb_value call(mrb_state* mrb, unsigned nargs, mrb_value* args) const override {
-        if(!check_args(mrb, nargs, args)) throw std::bad_function_call();
+        if(nargs != num_args) throw std::bad_function_call();
         return apply_function(mrb, args, std::index_sequence_for<P...>());
     }
 
     bool check_args(mrb_state* mrb, unsigned nargs, mrb_value* args) const override {
-        if(nargs != sizeof...(P)) return false;
-        return check_arg_types<P...>(mrb, args, false);
+        if(nargs != num_args) return false;
+        return check_arg_types(mrb, args, arg_type_table<P...>.data(), num_args, false);
     }
 
     std::string signature(mrb_state* mrb) const override {
-        std::string result = "(";
-        std::vector<std::string> arg_types =
-            { get_cpp_class_name<P>(mrb)... };
-        auto i = arg_types.size();
-        for(const auto& arg_type : arg_types) {
-            i -= 1;
-            result += arg_type;
-            if(i != 0) result += ", ";
-        }
-        result += ") -> " + get_cpp_class_name<R>(mrb);
-        return result;
+        return build_signature(mrb, arg_type_table<P...>.data(), sizeof...(P),
+                               &get_cpp_class_name<R>);
+    }
+
+    unsigned arity() const override {
+        return num_args;
     }
 
     private:
 
+    template<size_t I>
+    static mrb_value arg(mrb_state* mrb, mrb_value* args) {
+        if constexpr (takes_block && I == num_args) return current_block(mrb);
+        else return args[I];
+    }
+
+    // Checks and converts the arguments in a single pass, stopping
+    // at the first argument that does not have the expected type.
     template<size_t ... I>
     mrb_value apply_function(mrb_state* mrb, mrb_value* args, std::index_sequence<I...>) const {
-        return make_function_return_mrb_value<decltype(m_function)>::call(
-            mrb, m_function, type_converter<P>::convert(mrb, args[I])...);
+        std::tuple<arg_converter<P>...> converters;
+        bool converted = (std::get<I>(converters).convert(mrb, arg<I>(mrb, args)) && ... && true);
+        if(!converted) throw std::bad_function_call();
+        if constexpr (std::is_void<R>::value) {
+            m_function(std::get<I>(converters).get()...);
+            return mrb_nil_value();
+        } else {
+            return cpp_to_mrb<R>(mrb, m_function(std::get<I>(converters).get()...));
+        }
     }
 
+    protected:
+
     std::function<R(P...)> m_function;
 };
 
+template<typename Impl>
+mrb_value infallible_caller(mrb_state* mrb, mrb_value self);
+
+template<typename F, bool Pointer>
+class infallible_function_impl;
+
+/// Function that cannot fail: it is noexcept and all its parameters have
+/// infallible binders. Its method is implemented by a dedicated C function
+/// that converts the arguments without checking them and does not need
+/// to handle C++ exceptions. If Pointer is true, the function (a function
+/// pointer or captureless lambda) is called through a plain pointer
+/// rather than through the std::function kept for the generic path.
+template<typename R, typename ... P, bool Pointer>
+class infallible_function_impl<R(P...), Pointer> : public function_impl<R(P...)> {
+
+    public:
+
+    using pointer_type = R(*)(P...);
+
+    template<typename ... Extra>
+    infallible_function_impl(pointer_type fun, const Extra&... extra)
+    : function_impl<R(P...)>(std::function<R(P...)>(fun), extra...)
+    , m_pointer(fun) {}
+
+    template<typename ... Extra>
+    infallible_function_impl(std::function<R(P...)>&& fun, const Extra&... extra)
+    : function_impl<R(P...)>(std::move(fun), extra...) {}
+
+    static constexpr unsigned num_args = sizeof...(P);
+
+    mrb_func_t caller() const override {
+        return &infallible_caller<infallible_function_impl>;
+    }
+
+    mrb_value invoke(mrb_state* mrb, mrb_value* args) const {
+        return invoke(mrb, args, std::index_sequence_for<P...>());
+    }
+
+    private:
+
+    template<size_t ... I>
+    mrb_value invoke(mrb_state* mrb, mrb_value* args, std::index_sequence<I...>) const {
+        if constexpr (std::is_void<R>::value) {
+            target()(type_binder<std::decay_t<P>>::mrb_to_cpp(mrb, args[I])...);
+            return mrb_nil_value();
+        } else {
+            return cpp_to_mrb<R>(mrb, target()(type_binder<std::decay_t<P>>::mrb_to_cpp(mrb, args[I])...));
+        }
+    }
+
+    decltype(auto) target() const {
+        if constexpr (Pointer) return m_pointer;
+        else return (this->m_function);
+    }
+
+    pointer_type m_pointer = nullptr;
+};
+
+/// True if a noexcept function with parameters P can skip the checks
+template<typename ... P>
+constexpr bool is_infallible_signature = (is_infallible_arg<P>::value && ... && true)
+                                      && !ends_with_block<P...>::value;
+
+template<typename F, typename Sig>
+struct is_nothrow_callable_as : std::false_type {};
+
+template<typename F, typename R, typename ... P>
+struct is_nothrow_callable_as<F, R(P...)>
+: std::integral_constant<bool, std::is_nothrow_invocable_r<R, F&, P...>::value> {};
+
+template<typename F>
+class async_function_impl;
+
+/// Function bound with async_offload: the arguments are converted on
+/// the interpreter's thread, then the function runs on the thread pool
+/// while the method returns a Future.
+template<typename R, typename ... P>
+class async_function_impl<R(P...)> : public abstract_function {
+
+    public:
+
+    static_assert(count_blocks<P...> == 0,
+                  "A function offloaded to a thread pool cannot take a block");
+    static_assert(!((std::is_lvalue_reference<P>::value
+                  && !std::is_const<std::remove_reference_t<P>>::value) || ...),
+                  "A function offloaded to a thread pool cannot take non-const references");
+    static_assert(!(is_borrowed_arg<P>::value || ...),
+                  "A function offloaded to a thread pool must take arguments owning their data "
+                  "(e.g. std::string rather than const char*, string_view, views or Ruby values)");
+
+    async_function_impl(std::function<R(P...)>&& fun, thread_pool& pool)
+    : m_function(std::make_shared<std::function<R(P...)>>(std::move(fun)))
+    , m_pool(pool) {}
+
+    mrb_value call(mrb_state* mrb, unsigned nargs, mrb_value* args) const override {
+        if(nargs != sizeof...(P)) throw std::bad_function_call();
+        return offload(mrb, args, std::index_sequence_for<P...>());
+    }
+
+    bool check_args(mrb_state* mrb, unsigned nargs, mrb_value* args) const override {
+        if(nargs != sizeof...(P)) return false;
+        return check_arg_types(mrb, args, arg_type_table<P...>.data(), sizeof...(P), false);
+    }
+
+    std::string signature(mrb_state* mrb) const override {
+        return build_signature(mrb, arg_type_table<P...>.data(), sizeof...(P),
+                               [](mrb_state* mrb) {
+                                   return "Future<" + get_cpp_class_name<R>(mrb) + ">";
+                               });
+    }
+
+    unsigned arity() const override {
+        return sizeof...(P);
+    }
+
+    private:
+
+    template<size_t ... I>
+    mrb_value offload(mrb_state* mrb, mrb_value* args, std::index_sequence<I...>) const {
+        std::tuple<arg_converter<P>...> converters;
+        bool converted = (std::get<I>(converters).convert(mrb, args[I]) && ... && true);
+        if(!converted) throw std::bad_function_call();
+        auto task = std::make_shared<std::packaged_task<R()>>(
+            [fun = m_function,
+             params = std::tuple<std::decay_t<P>...>(std::get<I>(converters).get()...)]() mutable -> R {
+                return std::apply(*fun, std::move(params));
+            });
+        auto future = std::make_unique<future_impl<R>>(task->get_future());
+        m_pool.submit([task]() { (*task)(); });
+        return make_future(mrb, std::move(future));
+    }
+
+    std::shared_ptr<std::function<R(P...)>> m_function;
+    thread_pool&                            m_pool;
+};
+
+// Make the implementation of a function, offloaded to a thread pool
+// if an async_offload descriptor is among the extra arguments. Nothrow
+// is true if the function wrapped in f is noexcept.
+template<bool Nothrow = false, typename R, typename ... P, typename ... Extra>
+std::unique_ptr<abstract_function>
+make_function_impl(std::function<R(P...)>&& f, const Extra&... extra) {
+    if constexpr (has_async_offload<Extra...>) {
+        using function_type = async_function_impl<R(P...)>;
+        return std::make_unique<function_type>(std::move(f), *find_offload_pool(extra...));
+    } else if constexpr (Nothrow && is_infallible_signature<P...>) {
+        using function_type = infallible_function_impl<R(P...), false>;
+        return std::make_unique<function_type>(std::move(f), extra...);
+    } else {
+        using function_type = function_impl<R(P...)>;
+        return std::make_unique<function_type>(std::move(f), extra...);
+    }
+}
+
+// Same as above for a function pointer, which infallible functions
+// call directly
+template<bool Nothrow = false, typename R, typename ... P, typename ... Extra>
+std::unique_ptr<abstract_function>
+make_function_impl(R(*f)(P...), const Extra&... extra) {
+    if constexpr (!has_async_offload<Extra...> && Nothrow && is_infallible_signature<P...>) {
+        using function_type = infallible_function_impl<R(P...), true>;
+        return std::make_unique<function_type>(f, extra...);
+    } else {
+        return make_function_impl<Nothrow>(std::function<R(P...)>(f), extra...);
+    }
+}
+
 // Make a function from a std::function rvalue ref
 template<typename R, typename ... P, typename ... Extra>
 std::unique_ptr<abstract_function>
 make_function(std::function<R(P...)>&& f, const Extra&... extra) {
-    using function_type = function_impl<R(P...)>;
-    return std::make_unique<function_type>(std::move(f), extra...);
+    return make_function_impl(std::move(f), extra...);
 }
 
 // Make a function from an const std::function ref
@@ -127,8 +329,14 @@ make_function(const std::function<R(P...)>& f, const Extra&... extra) {
 template<typename R, typename ... Params, typename ... Extra>
 std::unique_ptr<abstract_function>
 make_function(R(*f)(Params...), const Extra&... extra) {
-    using function_type = function_impl<R(Params...)>;
-    return std::make_unique<function_type>(f, extra...);
+    return make_function_impl(f, extra...);
+}
+
+// Make a function from a noexcept function pointer
+template<typename R, typename ... Params, typename ... Extra>
+std::unique_ptr<abstract_function>
+make_function(R(*f)(Params...) noexcept, const Extra&... extra) {
+    return make_function_impl<true>(static_cast<R(*)(Params...)>(f), extra...);
 }
 
 // Make a function from any other object (lambda, object with operator(), etc.)
@@ -137,15 +345,24 @@ std::enable_if_t< !is_std_function_object<std::decay_t<Function>>::value
                && !std::is_function<std::remove_pointer_t<Function>>::value,
     std::unique_ptr<abstract_function>>
 make_function(Function f, const Extra&... extra) {
-    using function_type = function_impl<function_signature_t<std::decay_t<Function>>>;
-    using std_function_type = std::function<function_signature_t<std::decay_t<Function>>>;
-    return std::make_unique<function_type>(std_function_type(std::forward<Function>(f)), extra...);
-} 
+    using signature = function_signature_t<std::decay_t<Function>>;
+    constexpr bool nothrow = is_nothrow_callable_as<std::decay_t<Function>, signature>::value;
+    if constexpr (std::is_convertible<Function, signature*>::value) {
+        // Captureless lambdas are converted into function pointers, so that
+        // all the bindings with the same signature share the same code
+        return make_function_impl<nothrow>(static_cast<signature*>(f), extra...);
+    } else {
+        using std_function_type = std::function<signature>;
+        return make_function_impl<nothrow>(std_function_type(std::move(f)), extra...);
+    }
+}
 
 } // namespace detail
 
 inline void delete_function(mrb_state* mrb, void* f);
 
+inline mrb_value function_caller(mrb_state* mrb, mrb_value self);
+
 class function {
 
     public:
@@ -155,7 +372,9 @@ class function {
     template<typename Function, typename ... Extra>
     function(std::string name, Function fun, const Extra&... extra)
     : m_name(std::move(name))
-    , m_impl(detail::make_function(fun, extra...)) {}
+    , m_impl(detail::make_function(fun, extra...)) {
+        (apply_extra(extra), ...);
+    }
 
     function(const function& other) = delete;
 
@@ -172,6 +391,27 @@ class function {
         else throw std::bad_function_call();
     }
 
+    /**
+     * @brief Same as call, going through the cache of the function if
+     * it is memoized. holder is the Ruby object wrapping the function,
+     * which keeps the cached results alive.
+     */
+    mrb_value call_cached(mrb_state* mrb, mrb_value holder, unsigned nargs, mrb_value* args) const {
+        if(!m_cache) return call(mrb, nargs, args);
+        std::string key;
+        if(!m_cache->make_key(mrb, nargs, args, key))
+            return call(mrb, nargs, args);
+        mrb_value result;
+        if(m_cache->lookup(mrb, key, result)) return result;
+        result = call(mrb, nargs, args);
+        m_cache->store(mrb, holder, key, result);
+        return result;
+    }
+
+    detail::memo_cache* cache() const {
+        return m_cache.get();
+    }
+
     bool check_args(mrb_state* mrb, unsigned nargs, mrb_value* args) const {
         if(m_impl) return m_impl->check_args(mrb, nargs, args);
         else return false;
@@ -182,10 +422,31 @@ class function {
         else return std::string();
     }
 
+    unsigned arity() const {
+        if(m_impl) return m_impl->arity();
+        else return 0;
+    }
+
     const std::string& name() const {
         return m_name;
     }
 
+    /**
+     * @brief Returns the C function implementing the methods bound to
+     * this function: a dedicated one for functions that cannot fail and
+     * are not memoized, function_caller otherwise.
+     */
+    mrb_func_t caller() const {
+        if(m_impl && !m_cache) {
+            if(auto f = m_impl->caller()) return f;
+        }
+        return function_caller;
+    }
+
+    const detail::abstract_function* impl() const {
+        return m_impl.get();
+    }
+
     static inline const mrb_data_type datatype = {
         "cpp_function",
         delete_function
@@ -195,35 +456,94 @@ class function {
 
     std::string                                m_name;
     std::unique_ptr<detail::abstract_function> m_impl;
+    std::unique_ptr<detail::memo_cache>        m_cache;
+
+    void apply_extra(const memoize& m) {
+        m_cache = std::make_unique<detail::memo_cache>(m.capacity);
+    }
+
+    template<typename Extra>
+    void apply_extra(const Extra&) {}
 
 };
 
-inline void delete_function(mrb_state*, void* f) {
-    delete static_cast<function*>(f);
+inline void delete_function(mrb_state* mrb, void* f) {
+    auto fptr = static_cast<function*>(f);
+    auto s = detail::get_state(mrb);
+    if(fptr->cache() && s) {
+        auto range = s->memo_caches.equal_range(fptr->name());
+        for(auto it = range.first; it != range.second; ++it) {
+            if(it->second != fptr->cache()) continue;
+            s->memo_caches.erase(it);
+            break;
+        }
+    }
+    delete fptr;
+}
+
+namespace detail {
+
+/// Calls the function bound to the current method. A Ruby exception
+/// raised by a block called by the function is returned in exc once
+/// the function's frames are unwound.
+inline mrb_value call_bound_function(mrb_state* mrb, mrb_value& exc) {
+    mrb_value fun_val = mrb_proc_cfunc_env_get(mrb, 0);
+    auto fptr = static_cast<const function*>(DATA_PTR(fun_val));
+    trace_scope trace(trace_category::call, fptr->name());
+    try {
+        return fptr->call_cached(mrb, fun_val, mrb_get_argc(mrb), mrb_get_argv(mrb));
+    } catch(const ruby_exception& e) {
+        exc = e.value();
+        return mrb_nil_value();
+    }
+}
+
+} // namespace detail
+
+/// C function of the methods bound to C++ functions. The function object
+/// is stored in the environment of the method's proc, and the arguments
+/// are read directly from the VM stack, so no splat array is allocated.
+inline mrb_value function_caller(mrb_state* mrb, mrb_value self) {
+    mrb_value exc = mrb_nil_value();
+    mrb_value result = detail::call_bound_function(mrb, exc);
+    if(!mrb_nil_p(exc)) mrb_exc_raise(mrb, exc);
+    detail::sample_point(mrb);
+    return result;
+}
+
+namespace detail {
+
+/// C function of the methods bound to infallible functions. Only the
+/// number of arguments is checked, reporting a mismatch the same way
+/// as function_impl::call.
+template<typename Impl>
+mrb_value infallible_caller(mrb_state* mrb, mrb_value self) {
+    mrb_value fun_val = mrb_proc_cfunc_env_get(mrb, 0);
+    auto fptr = static_cast<const function*>(DATA_PTR(fun_val));
+    if(mrb_get_argc(mrb) != Impl::num_args) throw std::bad_function_call();
+    mrb_value result;
+    {
+        trace_scope trace(trace_category::call, fptr->name());
+        result = static_cast<const Impl*>(fptr->impl())->invoke(mrb, mrb_get_argv(mrb));
+    }
+    sample_point(mrb);
+    return result;
 }
 
-inline mrb_value function_overload_resolver(mrb_state* mrb, mrb_value self) {
-    RClass* mod = mrb_class(mrb, self);
-    // get arguments
-    mrb_value* args;
-    uint32_t narg;
-    mrb_get_args(mrb, "*", &args, &narg);
-    // get current method name
-    mrb_value kernel = mrb_class_find_path(mrb, mrb->kernel_module);
-    mrb_value fun_name_val = mrb_funcall(mrb, kernel, "__method__", 0);
-    std::string fun_name = detail::mrb_to_cpp<std::string>(mrb, fun_name_val);
-    // make instance name
-    std::string __fun_name__ = std::string("__") + fun_name + "__";
-    // retrieve function pointer
-    mrb_sym name_sym = mrb_intern_cstr(mrb, __fun_name__.c_str());
-    mrb_value fun_val = mrb_mod_cv_get(mrb, mod, name_sym);
-    function* fptr = nullptr;
-    Data_Get_Struct(mrb, fun_val, &function::datatype, fptr);
-    // TODO check that the function is not null
-    // call the function
-    return fptr->call(mrb, narg, args);
+/// Defines a method implemented by a C function, passing the given
+/// values as the function's environment. MRuby 2.1 has no argument
+/// spec slot in mrb_define_method_raw; functions that take arguments
+/// check their number themselves.
+inline void define_method_with_env(mrb_state* mrb, struct RClass* cls, const char* name,
+                                   mrb_func_t func, mrb_int nenv, const mrb_value* env) {
+    struct RProc* proc = mrb_proc_new_cfunc_with_env(mrb, func, nenv, env);
+    mrb_method_t method;
+    MRB_METHOD_FROM_PROC(method, proc);
+    mrb_define_method_raw(mrb, cls, mrb_intern_cstr(mrb, name), method);
 }
 
+} // namespace detail
+
 } // namespace mrbind17
 
 #endif
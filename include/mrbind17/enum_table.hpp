@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_ENUM_TABLE_H_
+#define MRBIND17_ENUM_TABLE_H_
+
+#include <mruby.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Mapping between the symbols and the values of a C++ enum bound with
+/// module::def_enum. Both directions are indexed arrays, built when the
+/// enumerators are registered: symbol ids are small consecutive integers,
+/// and so are the values of most enums. Sparse ranges (e.g. bit flags)
+/// fall back to hash maps.
+class enum_table {
+
+  public:
+
+  /// Registers an enumerator. The lookup arrays are only updated by
+  /// rebuild, called once all the enumerators have been added.
+  void add(mrb_sym sym, int64_t value) {
+    m_entries.emplace_back(sym, value);
+  }
+
+  /// Builds the lookup arrays (or maps) from the registered enumerators.
+  void rebuild() {
+    if(m_entries.empty()) return;
+    mrb_sym min_sym = m_entries.front().first, max_sym = min_sym;
+    int64_t min_val = m_entries.front().second, max_val = min_val;
+    for(const auto& [sym, value] : m_entries) {
+      min_sym = std::min(min_sym, sym);
+      max_sym = std::max(max_sym, sym);
+      min_val = std::min(min_val, value);
+      max_val = std::max(max_val, value);
+    }
+    m_by_sym.clear();
+    m_sym_map.clear();
+    m_sparse_syms = !dense(max_sym - min_sym, m_entries.size());
+    m_sym_base    = min_sym;
+    if(!m_sparse_syms) m_by_sym.resize(max_sym - min_sym + 1);
+    m_by_value.clear();
+    m_value_map.clear();
+    m_sparse_values = !dense(static_cast<uint64_t>(max_val) - static_cast<uint64_t>(min_val),
+                             m_entries.size());
+    m_value_base    = min_val;
+    if(!m_sparse_values) m_by_value.resize(static_cast<uint64_t>(max_val - min_val) + 1, 0);
+    for(const auto& [sym, value] : m_entries) {
+      if(m_sparse_syms) m_sym_map.emplace(sym, value);
+      else m_by_sym[sym - min_sym] = { true, value };
+      if(m_sparse_values) m_value_map.emplace(value, sym);
+      else {
+        auto& slot = m_by_value[static_cast<uint64_t>(value - min_val)];
+        if(!slot) slot = sym;
+      }
+    }
+  }
+
+  /// Looks up the value of a symbol, returning false if the
+  /// symbol is not the name of an enumerator.
+  bool to_value(mrb_sym sym, int64_t& value) const {
+    if(!m_sparse_syms) {
+      if(sym < m_sym_base || sym - m_sym_base >= m_by_sym.size()) return false;
+      const auto& slot = m_by_sym[sym - m_sym_base];
+      if(!slot.first) return false;
+      value = slot.second;
+      return true;
+    }
+    auto it = m_sym_map.find(sym);
+    if(it == m_sym_map.end()) return false;
+    value = it->second;
+    return true;
+  }
+
+  /// Returns the symbol of a value (the first registered one if several
+  /// enumerators share the value), or 0 if the value has no name.
+  mrb_sym to_symbol(int64_t value) const {
+    if(!m_sparse_values) {
+      if(value < m_value_base) return 0;
+      uint64_t index = static_cast<uint64_t>(value - m_value_base);
+      return index < m_by_value.size() ? m_by_value[index] : 0;
+    }
+    auto it = m_value_map.find(value);
+    return it == m_value_map.end() ? 0 : it->second;
+  }
+
+  size_t size() const {
+    return m_entries.size();
+  }
+
+  private:
+
+  static bool dense(uint64_t range, size_t count) {
+    return range <= 4 * count + 64;
+  }
+
+  std::vector<std::pair<mrb_sym, int64_t>> m_entries;
+
+  bool                                     m_sparse_syms = false;
+  mrb_sym                                  m_sym_base    = 0;
+  std::vector<std::pair<bool, int64_t>>    m_by_sym;
+  std::unordered_map<mrb_sym, int64_t>     m_sym_map;
+
+  bool                                     m_sparse_values = false;
+  int64_t                                  m_value_base    = 0;
+  std::vector<mrb_sym>                     m_by_value;
+  std::unordered_map<int64_t, mrb_sym>     m_value_map;
+};
+
+/// Index of an enum type in the per-interpreter vector of enum tables,
+/// assigned the first time the type is used.
+inline size_t next_enum_type_index() {
+  static std::atomic<size_t> next = { 0 };
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename E>
+size_t enum_type_index() {
+  static const size_t index = next_enum_type_index();
+  return index;
+}
+
+} // namespace detail
+
+}
+
+#endif
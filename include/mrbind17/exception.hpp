@@ -4,6 +4,7 @@
 #include <mrbind17/object.hpp>
 #include <mruby.h>
 #include <exception>
+#include <stdexcept>
 
 namespace mrbind17 {
 
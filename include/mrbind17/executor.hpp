@@ -0,0 +1,281 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_EXECUTOR_H_
+#define MRBIND17_EXECUTOR_H_
+
+#include <mrbind17/interpreter.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/variable.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Task queue owned by a single worker. The owner pushes and pops
+/// at the back (LIFO, cache friendly), idle workers steal from the front.
+template<typename Task>
+class work_stealing_queue {
+
+  public:
+
+  void push(Task&& task) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+
+  bool try_pop(Task& task) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_tasks.empty()) return false;
+    task = std::move(m_tasks.back());
+    m_tasks.pop_back();
+    return true;
+  }
+
+  bool try_steal(Task& task) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_tasks.empty()) return false;
+    task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+    return true;
+  }
+
+  private:
+
+  std::mutex       m_mutex;
+  std::deque<Task> m_tasks;
+};
+
+/// Index of the executor worker running on the current thread, if any.
+struct executor_worker_id {
+  const void* owner = nullptr;
+  size_t      index = 0;
+};
+
+inline executor_worker_id& current_executor_worker() {
+  static thread_local executor_worker_id id;
+  return id;
+}
+
+} // namespace detail
+
+/**
+ * @brief The executor owns a fixed set of worker threads, each with
+ * its own interpreter initialized by a common setup function.
+ * Scripts submitted to the executor are distributed across the
+ * workers' queues; idle workers steal from busy ones so that scripts
+ * of uneven cost are balanced across threads.
+ *
+ * Queues are only accessed under their own lock. The executor-wide
+ * mutex and condition variable are used only to put idle workers to
+ * sleep and wake them up: a submission takes the mutex only if some
+ * worker is sleeping.
+ *
+ * Results are converted to C++ values on the worker thread, since
+ * an mrb_value cannot leave the state that created it.
+ */
+class executor {
+
+  public:
+
+  using setup_function = std::function<void(interpreter&)>;
+
+  /**
+   * @brief Constructor. Starts the worker threads and waits for all
+   * their interpreters to be set up. If the setup function throws
+   * in any worker, the executor is shut down and the exception is
+   * rethrown.
+   *
+   * @param setup Function called on each worker's interpreter.
+   * @param num_threads Number of worker threads (defaults to the
+   * number of hardware threads).
+   */
+  explicit executor(setup_function setup = setup_function(),
+                    unsigned num_threads = std::thread::hardware_concurrency())
+  : m_setup(std::move(setup))
+  , m_queues(num_threads ? num_threads : 1) {
+    m_workers.reserve(m_queues.size());
+    for(size_t i = 0; i < m_queues.size(); i++)
+      m_workers.emplace_back([this, i]() { run(i); });
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]() { return m_num_ready == m_workers.size(); });
+    if(m_setup_error) {
+      lock.unlock();
+      shutdown();
+      std::rethrow_exception(m_setup_error);
+    }
+  }
+
+  executor(const executor&) = delete;
+
+  executor(executor&&) = delete;
+
+  executor& operator=(const executor&) = delete;
+
+  executor& operator=(executor&&) = delete;
+
+  /**
+   * @brief The destructor completes pending scripts then joins
+   * the worker threads.
+   */
+  ~executor() {
+    shutdown();
+  }
+
+  /**
+   * @brief Submits a script for execution. The arguments are
+   * converted in the worker's interpreter and made available to
+   * the script as the $args array.
+   *
+   * @tparam R C++ type of the script's result (may be void).
+   * @tparam Args Types of the arguments.
+   * @param script Ruby script.
+   * @param args Arguments passed to the script.
+   *
+   * @return A future holding the converted result, or the exception
+   * raised by the script.
+   */
+  template<typename R, typename ... Args>
+  std::future<R> submit(std::string script, Args&&... args) {
+    auto task = std::make_shared<std::packaged_task<R(interpreter&)>>(
+      [script = std::move(script),
+       params = std::make_tuple(std::decay_t<Args>(std::forward<Args>(args))...)]
+      (interpreter& interp) -> R {
+        std::apply([&interp](const auto&... p) {
+          set_script_args(interp, p...);
+        }, params);
+        return convert_result<R>(interp.execute(script.c_str()));
+      });
+    auto future = task->get_future();
+    enqueue([task](interpreter& interp) { (*task)(interp); });
+    return future;
+  }
+
+  /**
+   * @brief Returns the number of worker threads.
+   */
+  size_t size() const {
+    return m_workers.size();
+  }
+
+  private:
+
+  using task_type = std::function<void(interpreter&)>;
+
+  template<typename ... Args>
+  static void set_script_args(interpreter& interp, const Args&... args) {
+    mrb_state* mrb = interp.mrb();
+    int ai = mrb_gc_arena_save(mrb);
+    mrb_value array = mrb_ary_new_capa(mrb, sizeof...(Args));
+    (mrb_ary_push(mrb, array, detail::cpp_to_mrb(mrb, args)), ...);
+    mrb_gv_set(mrb, mrb_intern_lit(mrb, "$args"), array);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+
+  template<typename R>
+  static R convert_result(const object& result) {
+    if constexpr (std::is_void<R>::value) return;
+    else return result.as<R>();
+  }
+
+  void enqueue(task_type&& task) {
+    auto& self = detail::current_executor_worker();
+    size_t index = self.owner == this
+                 ? self.index
+                 : m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    m_queues[index].push(std::move(task));
+    m_num_pending.fetch_add(1);
+    // a worker going to sleep counts itself before checking m_num_pending,
+    // so either it sees the new task or we see it sleeping
+    if(m_num_sleeping.load() != 0) {
+      { std::lock_guard<std::mutex> lock(m_mutex); }
+      m_cv.notify_one();
+    }
+  }
+
+  bool try_get_task(size_t index, task_type& task) {
+    if(m_queues[index].try_pop(task)) return true;
+    for(size_t i = 1; i < m_queues.size(); i++) {
+      if(m_queues[(index + i) % m_queues.size()].try_steal(task))
+        return true;
+    }
+    return false;
+  }
+
+  /// Puts an idle worker to sleep until a task is pending. Returns false
+  /// once stopped with nothing pending.
+  bool wait_for_task() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_num_sleeping.fetch_add(1);
+    m_cv.wait(lock, [this]() { return m_num_pending.load() != 0 || m_stop; });
+    m_num_sleeping.fetch_sub(1);
+    return m_num_pending.load() != 0;
+  }
+
+  void run(size_t index) {
+    detail::current_executor_worker() = { this, index };
+    std::unique_ptr<interpreter> interp;
+    try {
+      interp = std::make_unique<interpreter>();
+      if(m_setup) m_setup(*interp);
+    } catch(...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(!m_setup_error) m_setup_error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_num_ready += 1;
+    }
+    m_cv.notify_all();
+    task_type task;
+    do {
+      while(try_get_task(index, task)) {
+        m_num_pending.fetch_sub(1);
+        task(*interp);
+        task = nullptr;
+      }
+    } while(wait_for_task());
+  }
+
+  void shutdown() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_stop) return;
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    for(auto& worker : m_workers)
+      if(worker.joinable()) worker.join();
+  }
+
+  setup_function                                   m_setup;
+  std::vector<detail::work_stealing_queue<task_type>> m_queues;
+  std::vector<std::thread>                         m_workers;
+  std::atomic<size_t>                              m_next_queue{0};
+  std::mutex                                       m_mutex;
+  std::condition_variable                          m_cv;
+  std::atomic<size_t>                              m_num_pending{0};
+  std::atomic<size_t>                              m_num_sleeping{0};
+  size_t                                           m_num_ready   = 0;
+  bool                                             m_stop        = false;
+  std::exception_ptr                               m_setup_error;
+};
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_GC_H_
+#define MRBIND17_GC_H_
+
+#include <mruby.h>
+#include <mruby/gc.h>
+#include <chrono>
+#include <cstddef>
+
+namespace mrbind17 {
+
+/**
+ * @brief Garbage collection modes supported by MRuby.
+ */
+enum class gc_mode {
+  incremental,
+  generational
+};
+
+/**
+ * @brief Snapshot of the state of an interpreter's garbage collector.
+ *
+ * Pause durations only account for the collections explicitly requested
+ * through interpreter::full_gc and interpreter::gc_step; collections
+ * triggered by allocations while a script runs are not timed.
+ */
+struct gc_stats {
+  size_t                   live_objects   = 0; /*!< Objects currently alive */
+  size_t                   heap_pages     = 0; /*!< Pages in the object heap */
+  gc_mode                  mode           = gc_mode::incremental;
+  bool                     disabled       = false;
+  int                      interval_ratio = 0;
+  int                      step_ratio     = 0;
+  size_t                   collections    = 0; /*!< Number of timed collections */
+  std::chrono::nanoseconds last_pause     = std::chrono::nanoseconds::zero();
+  std::chrono::nanoseconds max_pause      = std::chrono::nanoseconds::zero();
+  std::chrono::nanoseconds total_pause    = std::chrono::nanoseconds::zero();
+};
+
+/**
+ * @brief RAII object disabling the garbage collector of an interpreter
+ * for its lifetime, e.g. around a latency-sensitive section. The previous
+ * state is restored on destruction, so guards can be nested.
+ */
+class gc_disable_guard {
+
+  public:
+
+  explicit gc_disable_guard(mrb_state* mrb)
+  : m_mrb(mrb)
+  , m_was_disabled(mrb->gc.disabled) {
+    m_mrb->gc.disabled = true;
+  }
+
+  gc_disable_guard(const gc_disable_guard&) = delete;
+  gc_disable_guard& operator=(const gc_disable_guard&) = delete;
+
+  ~gc_disable_guard() {
+    m_mrb->gc.disabled = m_was_disabled;
+  }
+
+  private:
+
+  mrb_state* m_mrb;
+  bool       m_was_disabled;
+};
+
+namespace detail {
+
+/// Durations of the collections explicitly run by an interpreter
+struct gc_pause_stats {
+  size_t                   collections = 0;
+  std::chrono::nanoseconds last_pause  = std::chrono::nanoseconds::zero();
+  std::chrono::nanoseconds max_pause   = std::chrono::nanoseconds::zero();
+  std::chrono::nanoseconds total_pause = std::chrono::nanoseconds::zero();
+
+  void record(std::chrono::nanoseconds pause) {
+    collections += 1;
+    last_pause   = pause;
+    total_pause += pause;
+    if(pause > max_pause) max_pause = pause;
+  }
+};
+
+/// Runs one step of incremental collection with mrb_incremental_gc,
+/// which also computes the threshold of the next automatic step. In
+/// generational mode the step is a minor collection.
+inline void gc_incremental_step(mrb_state* mrb) {
+  mrb_incremental_gc(mrb);
+}
+
+} // namespace detail
+
+}
+
+#endif
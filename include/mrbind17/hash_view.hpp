@@ -0,0 +1,191 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_HASH_VIEW_H_
+#define MRBIND17_HASH_VIEW_H_
+
+#include <mrbind17/array_view.hpp>
+#include <mrbind17/type_binder.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/hash.h>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace mrbind17 {
+
+/**
+ * @brief The hash_view class gives access to a Ruby Hash from C++
+ * without converting it as a whole. Lookups convert only the key being
+ * looked up and the value found; iteration converts each pair when
+ * dereferenced. A hash_view can be used as the parameter type of a
+ * bound function; it is valid for the duration of the call.
+ *
+ * @tparam K C++ type of the keys.
+ * @tparam V C++ type of the values.
+ */
+template<typename K, typename V>
+class hash_view {
+
+  public:
+
+  using key_type    = K;
+  using mapped_type = V;
+  using value_type  = std::pair<K, V>;
+  using size_type   = size_t;
+
+  /**
+   * @brief Forward iterator over the pairs of the hash, in insertion order.
+   */
+  class iterator {
+
+    public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = std::pair<K, V>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = void;
+    using reference         = std::pair<K, V>;
+
+    iterator() = default;
+
+    std::pair<K, V> operator*() const {
+      mrb_state* mrb = m_view->m_mrb;
+      mrb_value key  = RARRAY_PTR(m_view->m_keys)[m_index];
+      mrb_value val  = mrb_hash_get(mrb, m_view->m_hash, key);
+      return std::pair<K, V>(
+          detail::convert_element<K>(mrb, key, "key", m_index),
+          detail::convert_element<V>(mrb, val, "value", m_index));
+    }
+
+    iterator& operator++() { ++m_index; return *this; }
+    iterator  operator++(int) { auto it = *this; ++m_index; return it; }
+
+    bool operator==(const iterator& other) const { return m_index == other.m_index; }
+    bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+
+    private:
+
+    friend class hash_view;
+
+    iterator(const hash_view* view, mrb_int index)
+    : m_view(view)
+    , m_index(index) {}
+
+    const hash_view* m_view  = nullptr;
+    mrb_int          m_index = 0;
+  };
+
+  using const_iterator = iterator;
+
+  hash_view(mrb_state* mrb, mrb_value hash)
+  : m_mrb(mrb)
+  , m_hash(hash) {}
+
+  size_t size() const { return mrb_hash_size(m_mrb, m_hash); }
+
+  bool empty() const { return size() == 0; }
+
+  /**
+   * @brief Looks up a key. Only the key and the value found are converted.
+   *
+   * @return The converted value, or an empty optional if the key is absent.
+   */
+  std::optional<V> find(const K& key) const {
+    mrb_value val = lookup(key);
+    if(mrb_undef_p(val)) return std::nullopt;
+    return detail::convert_element<V>(m_mrb, val, "value for key", 0);
+  }
+
+  bool contains(const K& key) const {
+    return !mrb_undef_p(lookup(key));
+  }
+
+  size_t count(const K& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  /**
+   * @brief Looks up a key, throwing std::out_of_range if it is absent.
+   */
+  V at(const K& key) const {
+    auto val = find(key);
+    if(!val) throw std::out_of_range("hash_view key not found");
+    return std::move(*val);
+  }
+
+  /**
+   * @brief Returns an iterator to the first pair. The keys are
+   * snapshotted in a Ruby Array the first time the view is iterated;
+   * neither keys nor values are converted until dereferenced.
+   */
+  iterator begin() const {
+    if(mrb_nil_p(m_keys)) m_keys = mrb_hash_keys(m_mrb, m_hash);
+    return iterator(this, 0);
+  }
+
+  iterator end() const {
+    if(mrb_nil_p(m_keys)) m_keys = mrb_hash_keys(m_mrb, m_hash);
+    return iterator(this, RARRAY_LEN(m_keys));
+  }
+
+  mrb_state* mrb() const { return m_mrb; }
+
+  mrb_value value() const { return m_hash; }
+
+  private:
+
+  mrb_value lookup(const K& key) const {
+    int ai = mrb_gc_arena_save(m_mrb);
+    mrb_value val = mrb_hash_fetch(m_mrb, m_hash,
+        detail::cpp_to_mrb<K>(m_mrb, key), mrb_undef_value());
+    mrb_gc_arena_restore(m_mrb, ai);
+    return val;
+  }
+
+  mrb_state*        m_mrb;
+  mrb_value         m_hash;
+  mutable mrb_value m_keys = mrb_nil_value();
+};
+
+/// Checks if a type is a hash_view
+template<typename T>
+struct is_hash_view : std::false_type {};
+
+template<typename K, typename V>
+struct is_hash_view<hash_view<K, V>> : std::true_type {};
+
+namespace detail {
+
+/// Hashes are accepted by hash_view parameters without checking
+/// their content, which is checked when accessed.
+template<typename View>
+struct type_binder<View, std::enable_if_t<is_hash_view<std::decay_t<View>>::value>> {
+
+  static constexpr bool borrowed = true;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const View& view) {
+    return view.value();
+  }
+
+  static auto mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return std::decay_t<View>(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_hash_p(val);
+  }
+
+};
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef MRBIND17_INSTANCE_H_
+#define MRBIND17_INSTANCE_H_
+
+#include <mrbind17/type_registry.hpp>
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <typeinfo>
+#include <type_traits>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Content of the Ruby object wrapping an instance of a bound C++ class.
+/// The instance is deleted along with the Ruby object only if owned is true.
+/// mapped is true if the object is registered in the identity map.
+template<typename T>
+struct instance {
+  T*   ptr    = nullptr;
+  bool owned  = false;
+  bool mapped = false;
+};
+
+template<typename T>
+struct instance_type;
+
+/// Removes the entry of the identity map pointing to inst, if any; the
+/// entry may already have been replaced by a newer wrapper.
+inline void forget_wrapper(mrb_state* mrb, const void* ptr,
+                           const mrb_data_type* type, const void* inst) {
+  auto s = get_state(mrb);
+  if(!s) return;
+  auto it = s->wrappers.find(wrapper_key{ ptr, type });
+  if(it != s->wrappers.end() && it->second.inst == inst) s->wrappers.erase(it);
+}
+
+template<typename T>
+void delete_instance(mrb_state* mrb, void* p) {
+  auto inst = static_cast<instance<T>*>(p);
+  if(!inst) return;
+  if(inst->mapped) forget_wrapper(mrb, inst->ptr, &instance_type<T>::datatype, inst);
+  if(inst->owned) delete inst->ptr;
+  delete inst;
+}
+
+/// Holds the mrb_data_type of the Ruby objects wrapping instances of T
+template<typename T>
+struct instance_type {
+  static inline const mrb_data_type datatype = {
+    typeid(T).name(),
+    delete_instance<T>
+  };
+};
+
+/// Wraps a pointer to a C++ instance into a new Ruby object of the class
+/// bound to T. Raises a TypeError if T has not been bound.
+template<typename T>
+mrb_value wrap_instance(mrb_state* mrb, T* ptr, bool owned) {
+  struct RClass* cls = get_cpp_class<T>(mrb);
+  if(!cls) {
+    if(owned) delete ptr;
+    auto type_name = get_cpp_class_name<T>(mrb);
+    mrb_raisef(mrb, E_TYPE_ERROR, "C++ type %S is not bound to a Ruby class",
+               mrb_str_new_cstr(mrb, type_name.c_str()));
+  }
+  auto inst = new instance<T>{ ptr, owned };
+  RData* data = Data_Wrap_Struct(mrb, cls, &instance_type<T>::datatype, static_cast<void*>(inst));
+  return mrb_obj_value(data);
+}
+
+/// Wraps a pointer to a C++ instance without taking ownership. The Ruby
+/// object is recorded in the identity map of the interpreter, so that
+/// wrapping the same instance again returns the same object as long as
+/// it is alive, which preserves equal? and saves an allocation.
+template<typename T>
+mrb_value wrap_unowned_instance(mrb_state* mrb, T* ptr) {
+  auto s = get_state(mrb);
+  if(!s) return wrap_instance<T>(mrb, ptr, false);
+  wrapper_key key{ ptr, &instance_type<T>::datatype };
+  auto it = s->wrappers.find(key);
+  // during a sweep, an unreachable wrapper may still be in the map
+  // because it has not been freed yet; it must not be resurrected
+  if(it != s->wrappers.end()
+  && !mrb_object_dead_p(mrb, reinterpret_cast<struct RBasic*>(it->second.data)))
+    return mrb_obj_value(it->second.data);
+  mrb_value val = wrap_instance<T>(mrb, ptr, false);
+  auto inst = static_cast<instance<T>*>(DATA_PTR(val));
+  s->wrappers[key] = wrapper_entry{ RDATA(val), inst };
+  inst->mapped = true;
+  return val;
+}
+
+/// Returns the C++ instance wrapped in a Ruby object, or nullptr if the
+/// object does not wrap an instance of T.
+template<typename T>
+T* get_instance(mrb_state* mrb, mrb_value val) {
+  if(!mrb_data_p(val) || DATA_TYPE(val) != &instance_type<T>::datatype) return nullptr;
+  auto inst = static_cast<instance<T>*>(DATA_PTR(val));
+  return inst ? inst->ptr : nullptr;
+}
+
+} // namespace detail
+
+} // namespace mrbind17
+
+#endif
@@ -9,12 +9,33 @@
 #include <mrbind17/object.hpp>
 #include <mrbind17/module.hpp>
 #include <mrbind17/exception.hpp>
+#include <mrbind17/symbol.hpp>
+#include <mrbind17/variable.hpp>
+#include <mrbind17/array_view.hpp>
+#include <mrbind17/hash_view.hpp>
+#include <mrbind17/byte_buffer.hpp>
+#include <mrbind17/iterable.hpp>
+#include <mrbind17/gc.hpp>
+#include <mrbind17/snapshot.hpp>
+#include <mrbind17/state.hpp>
+#include <mrbind17/interpreter_options.hpp>
+#include <mrbind17/trace.hpp>
+#include <mrbind17/compile_context.hpp>
+#include <mrbind17/autoload.hpp>
 #include <mruby.h>
 #include <mruby/compile.h>
+#include <mruby/proc.h>
 #include <mruby/variable.h>
 #include <string>
 #include <exception>
+#include <istream>
+#include <iterator>
+#include <stdexcept>
+#include <cstdio>
 #include <cstring>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 namespace mrbind17 {
 
@@ -31,7 +52,17 @@ class interpreter : public module {
    * @brief Constructor. Creates a new MRuby state.
    */
   interpreter()
-  : module(mrb_open()) {}
+  : interpreter(interpreter_options()) {}
+
+  /**
+   * @brief Constructor. Creates a new MRuby state as specified
+   * by the options, e.g. with only the core classes and the
+   * selected gems initialized.
+   *
+   * @param options Options.
+   */
+  explicit interpreter(const interpreter_options& options)
+  : interpreter(options, std::make_unique<detail::state>()) {}
 
   /**
    * @brief The copy-constructor is deleted.
@@ -42,7 +73,10 @@ class interpreter : public module {
    * @brief Move constructor.
    */
   interpreter(interpreter&& other)
-  : module(std::move(other)) {
+  : module(std::move(other))
+  , m_gc_pauses(other.m_gc_pauses)
+  , m_state(std::move(other.m_state))
+  , m_snapshot(std::move(other.m_snapshot)) {
     other.m_mrb = nullptr;
   }
 
@@ -58,6 +92,9 @@ class interpreter : public module {
     if(m_mrb == other.m_mrb) return *this;
     if(m_mrb) mrb_close(m_mrb);
     m_mrb = other.m_mrb;
+    m_gc_pauses = other.m_gc_pauses;
+    m_state = std::move(other.m_state);
+    m_snapshot = std::move(other.m_snapshot);
     other.m_mrb = nullptr;
     return *this;
   }
@@ -79,8 +116,12 @@ class interpreter : public module {
    */
   template<typename ValueType>
   void set_global(const char* name, const ValueType& val) {
-    mrb_sym sym = mrb_intern_static(m_mrb, name, strlen(name));
-    mrb_gv_set(m_mrb, sym, detail::cpp_to_mrb(m_mrb, val));
+    set_global(symbol(m_mrb, name), val);
+  }
+
+  template<typename ValueType>
+  void set_global(const symbol& name, const ValueType& val) {
+    mrb_gv_set(m_mrb, name.id(), detail::cpp_to_mrb(m_mrb, val));
   }
 
   /**
@@ -93,8 +134,230 @@ class interpreter : public module {
    */
   template<typename ValueType>
   ValueType get_global(const char* name) {
-    mrb_sym sym = mrb_intern_static(m_mrb, name, strlen(name));
-    return detail::mrb_to_cpp<ValueType>(m_mrb, mrb_gv_get(m_mrb, sym));
+    return get_global<ValueType>(symbol(m_mrb, name));
+  }
+
+  template<typename ValueType>
+  ValueType get_global(const symbol& name) {
+    return detail::mrb_to_cpp<ValueType>(m_mrb, mrb_gv_get(m_mrb, name.id()));
+  }
+
+  /**
+   * @brief Switches the garbage collector between incremental and
+   * generational mode. Switching out of generational mode completes
+   * the collection cycle in progress.
+   *
+   * @param mode New mode.
+   */
+  void set_gc_mode(gc_mode mode) {
+    bool generational = (mode == gc_mode::generational);
+    mrb_funcall(m_mrb, mrb_obj_value(mrb_module_get(m_mrb, "GC")),
+                "generational_mode=", 1, mrb_bool_value(generational));
+    check_exception();
+  }
+
+  /**
+   * @brief Returns the current mode of the garbage collector.
+   */
+  gc_mode get_gc_mode() const {
+    return m_mrb->gc.generational ? gc_mode::generational : gc_mode::incremental;
+  }
+
+  /**
+   * @brief Sets the interval ratio (in percent) controlling how much the
+   * heap may grow after a collection before the next cycle starts.
+   */
+  void set_gc_interval_ratio(int ratio) {
+    m_mrb->gc.interval_ratio = ratio;
+  }
+
+  int get_gc_interval_ratio() const {
+    return m_mrb->gc.interval_ratio;
+  }
+
+  /**
+   * @brief Sets the step ratio (in percent) controlling how much work
+   * each incremental step does.
+   */
+  void set_gc_step_ratio(int ratio) {
+    m_mrb->gc.step_ratio = ratio;
+  }
+
+  int get_gc_step_ratio() const {
+    return m_mrb->gc.step_ratio;
+  }
+
+  /**
+   * @brief Runs incremental collection steps until the current cycle
+   * completes or the time budget is exhausted, whichever comes first.
+   * A new cycle is started if none is in progress. This is meant to be
+   * called when the host is idle, e.g. between two requests.
+   *
+   * @param budget Maximum time to spend collecting. At least one step
+   * is run, so the budget may be exceeded by the duration of one step.
+   *
+   * @return true if a cycle was completed, false otherwise
+   * (including when the garbage collector is disabled).
+   */
+  template<typename Rep, typename Period>
+  bool gc_step(std::chrono::duration<Rep, Period> budget) {
+    if(m_mrb->gc.disabled || m_mrb->gc.iterating) return false;
+    detail::trace_scope trace(trace_category::gc, "gc_step");
+    auto start = std::chrono::steady_clock::now();
+    auto now   = start;
+    do {
+      detail::gc_incremental_step(m_mrb);
+      now = std::chrono::steady_clock::now();
+    } while(m_mrb->gc.state != MRB_GC_STATE_ROOT && now - start < budget);
+    m_gc_pauses.record(now - start);
+    return m_mrb->gc.state == MRB_GC_STATE_ROOT;
+  }
+
+  /**
+   * @brief Runs a full collection cycle, completing any cycle in progress.
+   * Does nothing if the garbage collector is disabled.
+   */
+  void full_gc() {
+    if(m_mrb->gc.disabled || m_mrb->gc.iterating) return;
+    detail::trace_scope trace(trace_category::gc, "full_gc");
+    auto start = std::chrono::steady_clock::now();
+    mrb_full_gc(m_mrb);
+    m_gc_pauses.record(std::chrono::steady_clock::now() - start);
+  }
+
+  /**
+   * @brief Disables the garbage collector until the returned guard is
+   * destroyed. Allocations made meanwhile grow the heap as needed.
+   *
+   * @return A guard object re-enabling the garbage collector.
+   */
+  gc_disable_guard disable_gc() {
+    return gc_disable_guard(m_mrb);
+  }
+
+  /**
+   * @brief Returns statistics about the garbage collector.
+   */
+  gc_stats get_gc_stats() const {
+    gc_stats stats;
+    stats.live_objects   = m_mrb->gc.live;
+    for(auto page = m_mrb->gc.heaps; page; page = page->next)
+      stats.heap_pages += 1;
+    stats.mode           = get_gc_mode();
+    stats.disabled       = m_mrb->gc.disabled;
+    stats.interval_ratio = m_mrb->gc.interval_ratio;
+    stats.step_ratio     = m_mrb->gc.step_ratio;
+    stats.collections    = m_gc_pauses.collections;
+    stats.last_pause     = m_gc_pauses.last_pause;
+    stats.max_pause      = m_gc_pauses.max_pause;
+    stats.total_pause    = m_gc_pauses.total_pause;
+    return stats;
+  }
+
+  /**
+   * @brief Discards the cached results of the memoized functions
+   * bound under the given name, in any module of the interpreter.
+   *
+   * @param name Name of the function.
+   */
+  void clear_memoized(const std::string& name) {
+    auto range = m_state->memo_caches.equal_range(name);
+    for(auto it = range.first; it != range.second; ++it)
+      it->second->clear(m_mrb);
+  }
+
+  /**
+   * @brief Discards the cached results of all the memoized functions.
+   */
+  void clear_memoized() {
+    for(auto& [name, cache] : m_state->memo_caches)
+      cache->clear(m_mrb);
+  }
+
+  /**
+   * @brief Returns the memory currently and at most allocated by the
+   * interpreter's MRuby state. Only available if the interpreter was
+   * created with interpreter_options::track_memory; zero otherwise.
+   */
+  memory_stats get_memory_stats() const {
+    memory_stats stats;
+    stats.current_bytes = m_state->allocated_bytes;
+    stats.peak_bytes    = m_state->peak_allocated_bytes;
+    return stats;
+  }
+
+  /**
+   * @brief Registers a Ruby script defining the constant name (a class
+   * or module, possibly nested, e.g. "Rules::Pricing"). The script is
+   * executed at top level the first time a script references the
+   * constant, so libraries that are never used cost nothing.
+   *
+   * @param name Full path of the constant.
+   * @param script Ruby source of the library.
+   */
+  void autoload(const std::string& name, std::string script) {
+    detail::autoload_entry entry{ detail::autoload_entry::kind::script, std::move(script) };
+    detail::add_autoload(m_mrb, name, std::move(entry));
+  }
+
+  /**
+   * @brief Same as autoload, reading the library from a file when it is
+   * first needed. The file may contain Ruby source or bytecode produced
+   * by mrbc.
+   */
+  void autoload_file(const std::string& name, std::string path) {
+    detail::autoload_entry entry{ detail::autoload_entry::kind::file, std::move(path) };
+    detail::add_autoload(m_mrb, name, std::move(entry));
+  }
+
+  /**
+   * @brief Same as autoload, for a library precompiled by mrbc, e.g.
+   * embedded in the application with mrbc -B. The bytecode is not
+   * copied and must outlive the interpreter.
+   */
+  void autoload_bytecode(const std::string& name, const uint8_t* bytecode, size_t size) {
+    detail::autoload_entry entry{ detail::autoload_entry::kind::bytecode, std::string(), bytecode, size };
+    detail::add_autoload(m_mrb, name, std::move(entry));
+  }
+
+  /**
+   * @brief Returns the constants whose library was autoloaded, in
+   * the order they were loaded.
+   */
+  const std::vector<std::string>& autoloaded() const {
+    return m_state->autoloaded;
+  }
+
+  /**
+   * @brief Records the current definitions of the interpreter (global
+   * variables, constants, classes, modules and methods, and instance
+   * variables of the top-level object) so that reset() can bring the
+   * interpreter back to this state, typically right after the bindings
+   * are set up. Replaces any previous checkpoint.
+   */
+  void checkpoint() {
+    if(m_snapshot) m_snapshot->release(m_mrb);
+    m_snapshot.reset();
+    m_snapshot = std::make_unique<detail::snapshot>(m_mrb);
+    detail::autoload_checkpoint(m_mrb);
+  }
+
+  /**
+   * @brief Brings the interpreter back to its last checkpoint: removes
+   * the global variables, constants, classes and methods defined since,
+   * restores the ones that were redefined or removed, clears any pending
+   * exception and runs a full garbage collection. This is much cheaper
+   * than closing the interpreter and setting up the bindings again.
+   *
+   * Objects existing at the checkpoint and modified in place since
+   * (e.g. a string stored in a constant) are not restored.
+   */
+  void reset() {
+    if(!m_snapshot) throw std::runtime_error("No checkpoint to reset the interpreter to");
+    m_snapshot->restore(m_mrb);
+    detail::autoload_reset(m_mrb);
+    m_mrb->exc = nullptr;
+    full_gc();
   }
 
   /**
@@ -105,13 +368,153 @@ class interpreter : public module {
    * @return The value returned by the Ruby script.
    */
   object execute(const char* script) {
-    auto val = mrb_load_string(m_mrb, script);
+    detail::trace_scope trace(trace_category::execute);
+    struct RProc* proc = compile(nullptr, "", [this, script](mrbc_context* cxt) {
+      return mrb_load_string_cxt(m_mrb, script, cxt);
+    });
+    auto val = run(proc, nullptr);
+    return object(m_mrb, val);
+  }
+
+  /**
+   * @brief Executes the given Ruby script in a persistent compile context,
+   * so that the script sees the local variables defined by the scripts
+   * previously executed with the same context.
+   *
+   * @param script Ruby script.
+   * @param cxt Compile context.
+   *
+   * @return The value returned by the Ruby script.
+   */
+  object execute(const char* script, compile_context& cxt) {
+    detail::trace_scope trace(trace_category::execute);
+    struct RProc* proc = compile(cxt.get(), "", [this, script](mrbc_context* c) {
+      return mrb_load_string_cxt(m_mrb, script, c);
+    });
+    auto val = run(proc, cxt.get());
+    return object(m_mrb, val);
+  }
+
+  /**
+   * @brief Executes a Ruby script read from an input stream. The parser
+   * pulls the script from the stream as it goes, so the script is never
+   * held in memory as a whole (except on platforms providing neither
+   * fopencookie nor funopen).
+   *
+   * @param is Input stream.
+   *
+   * @return The value returned by the Ruby script.
+   */
+  object execute(std::istream& is) {
+    return load_stream(is, nullptr);
+  }
+
+  object execute(std::istream& is, compile_context& cxt) {
+    return load_stream(is, cxt.get());
+  }
+
+  /**
+   * @brief Executes the Ruby script contained in a file. The file is
+   * parsed as it is read, and its name appears in backtraces.
+   *
+   * @param path Path of the file.
+   *
+   * @return The value returned by the Ruby script.
+   */
+  object execute_file(const std::string& path) {
+    return load_file(path, nullptr);
+  }
+
+  /**
+   * @brief Executes the Ruby script contained in a file in a persistent
+   * compile context. The file name of the context is left unchanged.
+   */
+  object execute_file(const std::string& path, compile_context& cxt) {
+    return load_file(path, cxt.get());
+  }
+
+  private:
+
+  interpreter(const interpreter_options& options, std::unique_ptr<detail::state> s)
+  : module(detail::open_state(options, s.get()))
+  , m_state(std::move(s)) {}
+
+  object load_stream(std::istream& is, mrbc_context* cxt) {
+    detail::trace_scope trace(trace_category::execute);
+    std::unique_ptr<FILE, int(*)(FILE*)> f(detail::open_istream(is), &fclose);
+    if(!f) {
+      std::string script{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+      struct RProc* proc = compile(cxt, "", [this, &script](mrbc_context* c) {
+        return mrb_load_nstring_cxt(m_mrb, script.data(), script.size(), c);
+      });
+      return object(m_mrb, run(proc, cxt));
+    }
+    struct RProc* proc = compile(cxt, "", [this, &f](mrbc_context* c) {
+      return mrb_load_file_cxt(m_mrb, f.get(), c);
+    });
+    f.reset();
+    return object(m_mrb, run(proc, cxt));
+  }
+
+  object load_file(const std::string& path, mrbc_context* cxt) {
+    detail::trace_scope trace(trace_category::execute);
+    std::unique_ptr<FILE, int(*)(FILE*)> f(fopen(path.c_str(), "r"), &fclose);
+    if(!f) throw std::runtime_error("Could not open file " + path);
+    struct RProc* proc = compile(cxt, path, [this, &f](mrbc_context* c) {
+      return mrb_load_file_cxt(m_mrb, f.get(), c);
+    });
+    f.reset();
+    return object(m_mrb, run(proc, cxt));
+  }
+
+  // Compiles a script without running it, using the given context or
+  // a temporary one bearing the given file name
+  template<typename Loader>
+  struct RProc* compile(mrbc_context* cxt, const std::string& filename, Loader&& load) {
+    detail::trace_scope trace(trace_category::compile);
+    mrbc_context* c = cxt;
+    if(!c) {
+      c = mrbc_context_new(m_mrb);
+      if(!filename.empty()) mrbc_filename(m_mrb, c, filename.c_str());
+    }
+    c->no_exec = true;
+    auto val = load(c);
+    c->no_exec = false;
+    if(!cxt) mrbc_context_free(m_mrb, c);
+    check_exception();
+    return mrb_proc_ptr(val);
+  }
+
+  // Runs a compiled script at top level, as mrb_load_string would.
+  // With a context, the top-level stack of the previous scripts is kept
+  // so that their local variables remain visible.
+  mrb_value run(struct RProc* proc, mrbc_context* cxt) {
+    struct RClass* target = m_mrb->object_class;
+    unsigned keep = 0;
+    if(cxt) {
+      if(cxt->target_class) target = cxt->target_class;
+      if(cxt->keep_lv) keep = cxt->slen + 1;
+      else cxt->keep_lv = true;
+    }
+    MRB_PROC_SET_TARGET_CLASS(proc, target);
+    if(m_mrb->c->ci) m_mrb->c->ci->target_class = target;
+    auto val = mrb_top_run(m_mrb, proc, mrb_top_self(m_mrb), keep);
+    check_exception();
+    return val;
+  }
+
+  void check_exception() {
     if(m_mrb->exc) {
-      exception::translate_and_throw_exception(m_mrb, mrb_obj_value(m_mrb->exc));
+      auto exc = mrb_obj_value(m_mrb->exc);
+      m_mrb->exc = nullptr;
+      exception::translate_and_throw_exception(m_mrb, exc);
     }
-    return object(m_mrb, val);
   }
 
+  detail::gc_pause_stats            m_gc_pauses;
+  std::unique_ptr<detail::state>    m_state;
+  std::unique_ptr<detail::snapshot> m_snapshot;
+
 };
 
 }
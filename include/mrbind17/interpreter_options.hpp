@@ -0,0 +1,119 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_INTERPRETER_OPTIONS_H_
+#define MRBIND17_INTERPRETER_OPTIONS_H_
+
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Declares the initialization and finalization functions that
+ * MRuby's build system generates for a gem, so that the gem can be
+ * passed to interpreter_options with MRBIND17_GEM. Dashes in the name
+ * of the gem are replaced with underscores, e.g. mruby_string_ext for
+ * mruby-string-ext. Must be used at global scope.
+ */
+#define MRBIND17_DECLARE_GEM(name)                                  \
+  extern "C" void GENERATED_TMP_mrb_##name##_gem_init(mrb_state*);  \
+  extern "C" void GENERATED_TMP_mrb_##name##_gem_final(mrb_state*);
+
+#define MRBIND17_GEM(name)                   \
+  ::mrbind17::gem{ #name,                    \
+    &GENERATED_TMP_mrb_##name##_gem_init,    \
+    &GENERATED_TMP_mrb_##name##_gem_final }
+
+namespace mrbind17 {
+
+/**
+ * @brief A gem linked into the MRuby library, initialized on demand.
+ */
+struct gem {
+  const char* name;
+  void (*init)(mrb_state*);
+  void (*final)(mrb_state*);
+};
+
+/**
+ * @brief Options controlling how an interpreter creates its MRuby state.
+ *
+ * By default, the state is created with mrb_open, which initializes
+ * every gem linked into MRuby. With core_only, it is created with
+ * mrb_open_core and only the gems listed in gems are initialized, in
+ * order, which reduces startup time and per-state memory. Gems do not
+ * initialize their dependencies: list them first.
+ */
+struct interpreter_options {
+  bool             core_only    = false;
+  std::vector<gem> gems;                 /*!< Gems initialized with core_only */
+  bool             track_memory = false; /*!< Count the bytes allocated by the state */
+};
+
+/**
+ * @brief Memory allocated by an interpreter created with track_memory.
+ */
+struct memory_stats {
+  size_t current_bytes = 0;
+  size_t peak_bytes    = 0;
+};
+
+namespace detail {
+
+/// MRuby allocator counting the bytes held by a state, stored in its C++
+/// state. Each block is prefixed with its size.
+inline void* counting_allocf(mrb_state*, void* p, size_t size, void* ud) {
+  constexpr size_t header = alignof(std::max_align_t);
+  auto s = static_cast<state*>(ud);
+  char*  base     = nullptr;
+  size_t old_size = 0;
+  if(p) {
+    base = static_cast<char*>(p) - header;
+    std::memcpy(&old_size, base, sizeof(old_size));
+  }
+  if(size == 0) {
+    std::free(base);
+    s->allocated_bytes -= old_size;
+    return nullptr;
+  }
+  auto block = static_cast<char*>(std::realloc(base, size + header));
+  if(!block) return nullptr;
+  std::memcpy(block, &size, sizeof(size));
+  s->allocated_bytes += size;
+  s->allocated_bytes -= old_size;
+  if(s->allocated_bytes > s->peak_allocated_bytes)
+    s->peak_allocated_bytes = s->allocated_bytes;
+  return block + header;
+}
+
+/// Creates an MRuby state as requested by the options,
+/// attaching the given C++ state to it. mrb_open is equivalent
+/// to mrb_open_allocf with the default allocator.
+inline mrb_state* open_state(const interpreter_options& options, state* s) {
+  mrb_allocf allocf = options.track_memory ? &counting_allocf : &mrb_default_allocf;
+  void*      ud     = options.track_memory ? s : nullptr;
+  mrb_state* mrb    = options.core_only ? mrb_open_core(allocf, ud) : mrb_open_allocf(allocf, ud);
+  if(!mrb) throw std::runtime_error("Could not create MRuby state");
+  mrb->ud = s;
+  if(options.core_only) {
+    for(const auto& g : options.gems) {
+      int ai = mrb_gc_arena_save(mrb);
+      g.init(mrb);
+      mrb_gc_arena_restore(mrb, ai);
+      if(g.final) mrb_state_atexit(mrb, g.final);
+    }
+  }
+  return mrb;
+}
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,286 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_ITERABLE_H_
+#define MRBIND17_ITERABLE_H_
+
+#include <mrbind17/block.hpp>
+#include <mrbind17/type_binder.hpp>
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <mruby/variable.h>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Position in an iterable, pulling one element at a time
+class abstract_cursor {
+
+  public:
+
+  virtual ~abstract_cursor() = default;
+
+  /// Converts the next element into out, returning false at the end
+  virtual bool next(mrb_state* mrb, mrb_value& out) = 0;
+};
+
+/// Type-erased C++ sequence exposed to Ruby. Each call to each creates
+/// a new cursor.
+class abstract_iterable {
+
+  public:
+
+  virtual ~abstract_iterable() = default;
+
+  virtual std::unique_ptr<abstract_cursor> cursor() = 0;
+};
+
+template<typename T>
+T& unwrap_range(T& range) {
+  return range;
+}
+
+template<typename T>
+T& unwrap_range(std::reference_wrapper<T>& range) {
+  return range.get();
+}
+
+} // namespace detail
+
+/**
+ * @brief An iterable is returned by bound functions to expose a C++
+ * sequence to Ruby without materializing it. In Ruby, it is an
+ * Enumerable whose each method pulls the elements from the C++ sequence
+ * one at a time, converting them with their type_binder, so that e.g.
+ * first(10) only ever reads ten elements. Without a block, each returns
+ * an Enumerator, providing next, take, lazy, etc.
+ *
+ * The iterable owns the sequence (or a reference to it, if created from
+ * an std::reference_wrapper), which is kept alive as long as the Ruby
+ * object and the enumerators created from it are.
+ *
+ * Iterables are created with mrbind17::iterate and mrbind17::generate.
+ */
+template<typename Range>
+class iterable : public detail::abstract_iterable {
+
+  using iterator   = decltype(std::begin(detail::unwrap_range(std::declval<Range&>())));
+  using value_type = std::decay_t<decltype(*std::declval<iterator&>())>;
+
+  public:
+
+  explicit iterable(Range range)
+  : m_range(std::move(range)) {}
+
+  std::unique_ptr<detail::abstract_cursor> cursor() override {
+    auto& range = detail::unwrap_range(m_range);
+    return std::make_unique<cursor_impl>(std::begin(range), std::end(range));
+  }
+
+  private:
+
+  class cursor_impl : public detail::abstract_cursor {
+
+    public:
+
+    cursor_impl(iterator begin, iterator end)
+    : m_it(std::move(begin))
+    , m_end(std::move(end)) {}
+
+    bool next(mrb_state* mrb, mrb_value& out) override {
+      if(m_it == m_end) return false;
+      out = detail::cpp_to_mrb<value_type>(mrb, *m_it);
+      ++m_it;
+      return true;
+    }
+
+    private:
+
+    iterator m_it;
+    iterator m_end;
+  };
+
+  Range m_range;
+};
+
+/**
+ * @brief Pair of iterators usable as a range.
+ */
+template<typename Iterator>
+struct iterator_range {
+  Iterator first;
+  Iterator last;
+  Iterator begin() const { return first; }
+  Iterator end() const { return last; }
+};
+
+/**
+ * @brief An iterable pulling its elements from a generator, i.e. a
+ * callable returning an std::optional that is empty at the end of the
+ * sequence. Generators are single-pass: all the cursors share the
+ * generator's state.
+ */
+template<typename Generator>
+class generator_iterable : public detail::abstract_iterable {
+
+  using value_type = typename std::decay_t<decltype(std::declval<Generator&>()())>::value_type;
+
+  public:
+
+  explicit generator_iterable(Generator gen)
+  : m_generator(std::move(gen)) {}
+
+  std::unique_ptr<detail::abstract_cursor> cursor() override {
+    return std::make_unique<cursor_impl>(m_generator);
+  }
+
+  private:
+
+  class cursor_impl : public detail::abstract_cursor {
+
+    public:
+
+    explicit cursor_impl(Generator& gen)
+    : m_generator(gen) {}
+
+    bool next(mrb_state* mrb, mrb_value& out) override {
+      std::optional<value_type> value = m_generator();
+      if(!value) return false;
+      out = detail::cpp_to_mrb<value_type>(mrb, std::move(*value));
+      return true;
+    }
+
+    private:
+
+    Generator& m_generator;
+  };
+
+  Generator m_generator;
+};
+
+/**
+ * @brief Creates an iterable from a range (any object providing
+ * begin and end), taking ownership of the range. Pass std::ref(range)
+ * to iterate over a range without copying it; the range must then
+ * outlive the Ruby objects iterating over it.
+ */
+template<typename Range>
+iterable<std::decay_t<Range>> iterate(Range&& range) {
+  return iterable<std::decay_t<Range>>(std::forward<Range>(range));
+}
+
+/**
+ * @brief Creates an iterable from a pair of iterators.
+ */
+template<typename Iterator>
+iterable<iterator_range<Iterator>> iterate(Iterator first, Iterator last) {
+  return iterable<iterator_range<Iterator>>({ std::move(first), std::move(last) });
+}
+
+/**
+ * @brief Creates an iterable from a generator returning
+ * std::optional<T>, empty at the end of the sequence.
+ */
+template<typename Generator>
+generator_iterable<std::decay_t<Generator>> generate(Generator&& gen) {
+  return generator_iterable<std::decay_t<Generator>>(std::forward<Generator>(gen));
+}
+
+namespace detail {
+
+inline void delete_iterable(mrb_state*, void* p) {
+  delete static_cast<abstract_iterable*>(p);
+}
+
+inline const mrb_data_type iterable_datatype = { "cpp_iterable", delete_iterable };
+
+/// Returns the sequence of a CppIterable, raising a TypeError if the
+/// object is not initialized.
+inline abstract_iterable* get_iterable(mrb_state* mrb, mrb_value self) {
+  auto p = static_cast<abstract_iterable*>(mrb_data_get_ptr(mrb, self, &iterable_datatype));
+  if(!p) mrb_raisef(mrb, E_TYPE_ERROR, "uninitialized %S", mrb_obj_value(mrb_obj_class(mrb, self)));
+  return p;
+}
+
+/// CppIterable#each. The block is called with protected_call, so that
+/// an exception raised by the block, or a break out of it (e.g. from
+/// Enumerable#first), comes back here as mrb->exc and is raised again
+/// once the cursor is destroyed. Without a block, returns an Enumerator.
+inline mrb_value iterable_each(mrb_state* mrb, mrb_value self) {
+  mrb_value blk = mrb_nil_value();
+  mrb_get_args(mrb, "&", &blk);
+  if(mrb_nil_p(blk))
+    return mrb_funcall(mrb, self, "to_enum", 1, mrb_symbol_value(mrb_intern_lit(mrb, "each")));
+  auto it = get_iterable(mrb, self);
+  mrb_value exc = mrb_nil_value();
+  {
+    auto cursor = it->cursor();
+    int ai = mrb_gc_arena_save(mrb);
+    mrb_value value, result;
+    while(mrb_nil_p(exc) && cursor->next(mrb, value)) {
+      exc = protected_call(mrb, blk, 1, &value, result);
+      mrb_gc_arena_restore(mrb, ai);
+    }
+    if(!mrb_nil_p(exc)) mrb_gc_protect(mrb, exc);
+  }
+  if(!mrb_nil_p(exc)) mrb_exc_raise(mrb, exc);
+  return self;
+}
+
+/// Returns the CppIterable class, defining it the first time.
+/// The class is registered with the GC, so that it remains
+/// valid even if a script (or interpreter::reset) removes it.
+inline struct RClass* get_iterable_class(mrb_state* mrb) {
+  auto s = get_state(mrb);
+  if(!s) throw std::runtime_error("Iterables require a state created by an interpreter");
+  if(s->iterable_class) return s->iterable_class;
+  int ai = mrb_gc_arena_save(mrb);
+  struct RClass* cls = mrb_define_class(mrb, "CppIterable", mrb->object_class);
+  MRB_SET_INSTANCE_TT(cls, MRB_TT_DATA);
+  mrb_include_module(mrb, cls, mrb_module_get(mrb, "Enumerable"));
+  mrb_define_method(mrb, cls, "each", iterable_each, MRB_ARGS_BLOCK());
+  // instances are only created from C++
+  mrb_undef_class_method(mrb, cls, "new");
+  mrb_gc_register(mrb, mrb_obj_value(cls));
+  mrb_gc_arena_restore(mrb, ai);
+  s->iterable_class = cls;
+  return cls;
+}
+
+template<typename Iterable>
+struct type_binder<Iterable, std::enable_if_t<std::is_base_of<abstract_iterable, std::decay_t<Iterable>>::value>> {
+
+  using iterable_type = std::decay_t<Iterable>;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, iterable_type it) {
+    struct RClass* cls = get_iterable_class(mrb);
+    auto ptr = std::make_unique<iterable_type>(std::move(it));
+    auto data = Data_Wrap_Struct(mrb, cls, &iterable_datatype,
+                                 static_cast<abstract_iterable*>(ptr.get()));
+    ptr.release();
+    return mrb_obj_value(data);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return false;
+  }
+
+};
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_MEMOIZE_H_
+#define MRBIND17_MEMOIZE_H_
+
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/string.h>
+#include <mruby/variable.h>
+#include <cstring>
+#include <list>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+namespace mrbind17 {
+
+/**
+ * @brief Descriptor passed to def_function to cache the results of a
+ * pure function, i.e. a function whose result only depends on the value
+ * of its arguments. Calls with arguments already seen return the cached
+ * result without converting the arguments nor calling the function.
+ *
+ * Only calls whose arguments are all nil, booleans, numbers, symbols or
+ * strings are cached, and only results of these types are stored;
+ * other calls go through as usual. Cached strings are duplicated when
+ * returned, so scripts cannot alter the cache.
+ */
+struct memoize {
+
+    explicit memoize(size_t capacity = 1024)
+    : capacity(capacity) {}
+
+    size_t capacity; /*!< Maximum number of results kept */
+};
+
+/**
+ * @brief Shorthand for memoize() with the default capacity.
+ */
+inline memoize pure() {
+    return memoize();
+}
+
+namespace detail {
+
+template<typename ... Extra>
+constexpr bool has_memoize = (std::is_same<Extra, memoize>::value || ...);
+
+/// Bounded cache of the results of a function, keyed by the values of
+/// the arguments and evicting the least recently used result. The
+/// results are kept alive by a Ruby array attached to the object
+/// wrapping the function.
+class memo_cache {
+
+    public:
+
+    explicit memo_cache(size_t capacity)
+    : m_capacity(capacity) {}
+
+    /// Builds the key of a call, returning false if the arguments
+    /// cannot be used as a key. The key is owned by the caller, since
+    /// the function may be called again before its result is stored.
+    bool make_key(mrb_state* mrb, unsigned nargs, const mrb_value* args, std::string& key) const {
+        key.clear();
+        for(unsigned i = 0; i < nargs; i++) {
+            mrb_value v = args[i];
+            switch(mrb_type(v)) {
+                case MRB_TT_FALSE:
+                    key += mrb_nil_p(v) ? 'n' : 'f';
+                    break;
+                case MRB_TT_TRUE:
+                    key += 't';
+                    break;
+                case MRB_TT_FIXNUM:
+                    append(key, 'i', mrb_fixnum(v));
+                    break;
+                case MRB_TT_FLOAT:
+                    append(key, 'd', mrb_float(v));
+                    break;
+                case MRB_TT_SYMBOL:
+                    append(key, 's', mrb_symbol(v));
+                    break;
+                case MRB_TT_STRING:
+                    append(key, 'S', RSTRING_LEN(v));
+                    key.append(RSTRING_PTR(v), RSTRING_LEN(v));
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /// Looks up a key built by make_key
+    bool lookup(mrb_state* mrb, const std::string& key, mrb_value& result) {
+        auto it = m_entries.find(key);
+        if(it == m_entries.end()) return false;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        result = mrb_ary_ref(mrb, m_values, it->second.slot);
+        if(mrb_string_p(result)) result = mrb_str_dup(mrb, result);
+        return true;
+    }
+
+    /// Stores the result of the call whose key was built by make_key
+    void store(mrb_state* mrb, mrb_value holder, const std::string& key, mrb_value result) {
+        if(m_capacity == 0 || !cacheable(result)) return;
+        if(mrb_nil_p(m_values)) {
+            m_values = mrb_ary_new(mrb);
+            mrb_iv_set(mrb, holder, mrb_intern_lit(mrb, "__memo__"), m_values);
+        }
+        if(mrb_string_p(result)) result = mrb_str_dup(mrb, result);
+        // a re-entrant call with the same key may have stored it already
+        auto existing = m_entries.find(key);
+        if(existing != m_entries.end()) {
+            mrb_ary_set(mrb, m_values, existing->second.slot, result);
+            m_lru.splice(m_lru.begin(), m_lru, existing->second.lru);
+            return;
+        }
+        mrb_int slot;
+        if(m_entries.size() < m_capacity) {
+            slot = static_cast<mrb_int>(m_entries.size());
+        } else {
+            auto victim = m_entries.find(m_lru.back());
+            slot = victim->second.slot;
+            m_entries.erase(victim);
+            m_lru.pop_back();
+        }
+        mrb_ary_set(mrb, m_values, slot, result);
+        m_lru.push_front(key);
+        m_entries.emplace(key, entry{ slot, m_lru.begin() });
+    }
+
+    /// Discards all the cached results
+    void clear(mrb_state* mrb) {
+        m_entries.clear();
+        m_lru.clear();
+        if(!mrb_nil_p(m_values)) mrb_ary_clear(mrb, m_values);
+    }
+
+    size_t size() const {
+        return m_entries.size();
+    }
+
+    private:
+
+    struct entry {
+        mrb_int                          slot;
+        std::list<std::string>::iterator lru;
+    };
+
+    template<typename T>
+    static void append(std::string& key, char tag, const T& value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        key += tag;
+        key.append(bytes, sizeof(T));
+    }
+
+    static bool cacheable(mrb_value v) {
+        switch(mrb_type(v)) {
+            case MRB_TT_FALSE:
+            case MRB_TT_TRUE:
+            case MRB_TT_FIXNUM:
+            case MRB_TT_FLOAT:
+            case MRB_TT_SYMBOL:
+            case MRB_TT_STRING:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    size_t                                  m_capacity;
+    std::list<std::string>                  m_lru;
+    std::unordered_map<std::string, entry>  m_entries;
+    mrb_value                               m_values = mrb_nil_value();
+};
+
+} // namespace detail
+
+}
+
+#endif
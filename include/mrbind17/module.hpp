@@ -9,14 +9,23 @@
 //#include <mrbind17/function_binder.hpp>
 #include <mrbind17/cpp_function.hpp>
 #include <mrbind17/type_binder.hpp>
+#include <mrbind17/record.hpp>
+#include <mrbind17/symbol.hpp>
 #include <mruby/value.h>
 #include <string>
 #include <exception>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
 
 namespace mrbind17 {
 
 class object;
 
+template<typename T>
+class class_;
+
 class module {
 
     friend class object;
@@ -25,15 +34,7 @@ class module {
 
     template<typename Function, typename ... Extra>
     module& def_function(const char* name, Function&& f, const Extra&... extra) {
-        auto fptr = new function(name, std::forward<Function>(f), extra...);
-        std::string name_cptr = std::string("__") + name + "__";
-        RData* data = Data_Wrap_Struct(m_mrb, m_mrb->object_class, &function::datatype, static_cast<void*>(fptr));
-        mrb_value fun_val = mrb_obj_value(data);
-        //mrb_data_init(fun_val, static_cast<void*>(fptr), &datatype);
-        mrb_sym name_cptr_sym = mrb_intern_cstr(m_mrb, name_cptr.c_str());
-        mrb_mod_cv_set(m_mrb, m_module, name_cptr_sym, fun_val);
-        mrb_define_module_function(m_mrb, m_module, name, function_overload_resolver,  MRB_ARGS_ANY());
-        return *this;
+        return def_function(new function(name, std::forward<Function>(f), extra...));
     }
 
     /**
@@ -48,6 +49,19 @@ class module {
         return module(m_mrb, mod, name);
     }
 
+    /**
+     * @brief Defines a class inside this module, bound to the C++
+     * type T. If T is default-constructible, instances can be
+     * created from Ruby with new.
+     *
+     * @tparam T C++ type.
+     * @param name Name of the new class.
+     *
+     * @return The newly created class.
+     */
+    template<typename T>
+    class_<T> def_class(const char* name);
+
     /**
      * @brief Defines a constant inside this module.
      *
@@ -66,6 +80,55 @@ class module {
         return *this;
     }
 
+    /**
+     * @brief Binds the C++ enum E, whose values are then represented by
+     * symbols in Ruby, e.g. :running for state::running. The mapping
+     * is built once per interpreter and converting in either direction
+     * is an array lookup.
+     *
+     * @tparam E Enum type.
+     * @param name Name of the enum, used in error messages.
+     * @param values Names and values of the enumerators.
+     *
+     * @return A reference to the current module.
+     */
+    template<typename E>
+    module& def_enum(const char* name, std::initializer_list<std::pair<const char*, E>> values) {
+        static_assert(std::is_enum<E>::value, "def_enum requires an enum type");
+        auto s = detail::get_state(m_mrb);
+        if(!s) throw std::runtime_error("def_enum requires a state created by an interpreter");
+        size_t index = detail::enum_type_index<E>();
+        if(index >= s->enum_tables.size()) s->enum_tables.resize(index+1);
+        auto& table = s->enum_tables[index];
+        if(!table) table = std::make_unique<detail::enum_table>();
+        for(const auto& [enumerator, value] : values)
+            table->add(mrb_intern_cstr(m_mrb, enumerator), static_cast<int64_t>(value));
+        table->rebuild();
+        detail::register_cpp_class_name<E>(m_mrb, name);
+        return *this;
+    }
+
+    /**
+     * @brief Defines a Struct class named after the record type T, whose
+     * fields are described by record_traits<T>. Records of type T are
+     * then converted into instances of this class instead of hashes;
+     * both are accepted when converting back to T. Requires the
+     * mruby-struct gem.
+     *
+     * @tparam T Record type.
+     * @param name Name of the Struct class.
+     *
+     * @return A reference to the current module.
+     */
+    template<typename T>
+    module& def_record(const char* name) {
+        static_assert(detail::is_record<T>::value,
+                      "def_record requires a type described by record_traits");
+        detail::define_record_struct<T>(m_mrb, m_module, name);
+        detail::register_cpp_class_name<T>(m_mrb, name);
+        return *this;
+    }
+
     /**
      * @brief Includes a module inside the current module.
      *
@@ -78,6 +141,21 @@ class module {
         return *this;
     }
 
+    /**
+     * @brief Interns a name in this module's MRuby state.
+     *
+     * @param name Name to intern.
+     *
+     * @return A symbol that can be reused across calls.
+     */
+    symbol intern(static_name name) const {
+        return symbol(m_mrb, name);
+    }
+
+    symbol intern(std::string_view name) const {
+        return symbol(m_mrb, name);
+    }
+
     /**
      * @brief Checks if a particular function name is defined
      * in this module.
@@ -87,8 +165,11 @@ class module {
      * @return true if function is defined, false otherwise.
      */
     bool respond_to(const std::string& function_name) const {
-        mrb_sym function_name_sym = mrb_intern_cstr(m_mrb, function_name.c_str());
-        return mrb_obj_respond_to(m_mrb, m_module, function_name_sym);
+        return respond_to(symbol(m_mrb, function_name));
+    }
+
+    bool respond_to(const symbol& function_name) const {
+        return mrb_obj_respond_to(m_mrb, m_module, function_name.id());
     }
 
     /**
@@ -100,8 +181,11 @@ class module {
      * @return true if the variable is defined, false otherwise.
      */
     bool cv_defined(const std::string& variable_name) const {
-        mrb_sym variable_name_sym = mrb_intern_cstr(m_mrb, variable_name.c_str());
-        return mrb_mod_cv_defined(m_mrb, m_module, variable_name_sym);
+        return cv_defined(symbol(m_mrb, variable_name));
+    }
+
+    bool cv_defined(const symbol& variable_name) const {
+        return mrb_mod_cv_defined(m_mrb, m_module, variable_name.id());
     }
 
     /**
@@ -113,9 +197,12 @@ class module {
      * @return An object handle containing the value.
      */
     object cv_get(const std::string& variable_name) const {
+        return cv_get(symbol(m_mrb, variable_name));
+    }
+
+    object cv_get(const symbol& variable_name) const {
         if(!cv_defined(variable_name)) return object(m_mrb);
-        mrb_sym variable_name_sym = mrb_intern_cstr(m_mrb, variable_name.c_str());
-        return object(m_mrb, mrb_mod_cv_get(m_mrb, m_module, variable_name_sym));
+        return object(m_mrb, mrb_mod_cv_get(m_mrb, m_module, variable_name.id()));
     }
 
     /**
@@ -127,12 +214,44 @@ class module {
      */
     template<typename ValueType>
     void cv_set(const std::string& variable_name, const ValueType& val) {
-        mrb_sym variable_name_sym = mrb_intern_cstr(m_mrb, variable_name.c_str());
-        mrb_mod_cv_set(m_mrb, m_module, variable_name_sym, detail::cpp_to_mrb(m_mrb, val));
+        cv_set(symbol(m_mrb, variable_name), val);
+    }
+
+    template<typename ValueType>
+    void cv_set(const symbol& variable_name, const ValueType& val) {
+        mrb_mod_cv_set(m_mrb, m_module, variable_name.id(), detail::cpp_to_mrb(m_mrb, val));
+    }
+
+    /**
+     * @brief Returns the underlying MRuby state.
+     */
+    mrb_state* mrb() const {
+        return m_mrb;
+    }
+
+    /**
+     * @brief Returns the underlying MRuby module.
+     */
+    struct RClass* rclass() const {
+        return m_module;
     }
 
     protected:
 
+    // Non-template part of def_function, shared by all bindings
+    module& def_function(function* fptr) {
+        const char* name = fptr->name().c_str();
+        auto s = detail::get_state(m_mrb);
+        if(fptr->cache() && s) s->memo_caches.emplace(fptr->name(), fptr->cache());
+        RData* data = Data_Wrap_Struct(m_mrb, m_mrb->object_class, &function::datatype, static_cast<void*>(fptr));
+        mrb_value env[] = { mrb_obj_value(data) };
+        struct RClass* singleton = mrb_class_ptr(mrb_singleton_class(m_mrb, mrb_obj_value(m_module)));
+        mrb_func_t caller = fptr->caller();
+        detail::define_method_with_env(m_mrb, singleton, name, caller, 1, env);
+        detail::define_method_with_env(m_mrb, m_module, name, caller, 1, env);
+        return *this;
+    }
+
     mrb_state*     m_mrb    = nullptr;
     std::string    m_name   = "";
     struct RClass* m_module = nullptr;
@@ -147,4 +266,6 @@ class module {
 
 }
 
+#include <mrbind17/class.hpp>
+
 #endif
@@ -0,0 +1,136 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+
+// This file has no include guard on purpose: numeric_vector.hpp includes
+// it once per instruction set, with MRBIND17_SIMD_NAMESPACE naming the
+// namespace to define and MRBIND17_SIMD_BYTES the width of a vector.
+// It relies on the GCC/Clang vector extensions.
+
+namespace MRBIND17_SIMD_NAMESPACE {
+
+typedef double  vec  __attribute__((vector_size(MRBIND17_SIMD_BYTES)));
+typedef int64_t mask __attribute__((vector_size(MRBIND17_SIMD_BYTES)));
+
+constexpr size_t lanes = MRBIND17_SIMD_BYTES / sizeof(double);
+
+inline vec load(const double* p) {
+  vec v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline void store(double* p, vec v) {
+  std::memcpy(p, &v, sizeof(v));
+}
+
+inline vec broadcast(double x) {
+  vec v;
+  for(size_t i = 0; i < lanes; i++) v[i] = x;
+  return v;
+}
+
+inline vec select(mask m, vec a, vec b) {
+  return (vec)((m & (mask)a) | (~m & (mask)b));
+}
+
+inline vec to_number(mask m) {
+  return (vec)(m & (mask)broadcast(1.0));
+}
+
+template<numeric_op Op>
+inline vec apply(vec a, vec b) {
+  if constexpr (Op == numeric_op::add) return a + b;
+  if constexpr (Op == numeric_op::sub) return a - b;
+  if constexpr (Op == numeric_op::mul) return a * b;
+  if constexpr (Op == numeric_op::div) return a / b;
+  if constexpr (Op == numeric_op::min) return select(a < b, a, b);
+  if constexpr (Op == numeric_op::max) return select(a > b, a, b);
+  if constexpr (Op == numeric_op::lt)  return to_number(a < b);
+  if constexpr (Op == numeric_op::le)  return to_number(a <= b);
+  if constexpr (Op == numeric_op::gt)  return to_number(a > b);
+  if constexpr (Op == numeric_op::ge)  return to_number(a >= b);
+  if constexpr (Op == numeric_op::eq)  return to_number(a == b);
+}
+
+template<numeric_op Op>
+void map(const double* a, const double* b, double* out, size_t n) {
+  size_t i = 0;
+  for(; i + lanes <= n; i += lanes)
+    store(out + i, apply<Op>(load(a + i), load(b + i)));
+  for(; i < n; i++)
+    out[i] = scalar::apply<Op>(a[i], b[i]);
+}
+
+template<numeric_op Op>
+void map_scalar(const double* a, double s, double* out, size_t n) {
+  vec b = broadcast(s);
+  size_t i = 0;
+  for(; i + lanes <= n; i += lanes)
+    store(out + i, apply<Op>(load(a + i), b));
+  for(; i < n; i++)
+    out[i] = scalar::apply<Op>(a[i], s);
+}
+
+inline void clamp(const double* a, double lo, double hi, double* out, size_t n) {
+  vec vlo = broadcast(lo);
+  vec vhi = broadcast(hi);
+  size_t i = 0;
+  for(; i + lanes <= n; i += lanes)
+    store(out + i, apply<numeric_op::min>(apply<numeric_op::max>(load(a + i), vlo), vhi));
+  for(; i < n; i++)
+    out[i] = scalar::apply<numeric_op::min>(scalar::apply<numeric_op::max>(a[i], lo), hi);
+}
+
+/// Sums with two independent accumulators to hide the latency of
+/// vector additions. The result may differ from a sequential sum in
+/// the last bits, since additions are reordered.
+inline double sum(const double* a, size_t n) {
+  vec acc0 = broadcast(0.0);
+  vec acc1 = acc0;
+  size_t i = 0;
+  for(; i + 2*lanes <= n; i += 2*lanes) {
+    acc0 += load(a + i);
+    acc1 += load(a + i + lanes);
+  }
+  acc0 += acc1;
+  double s = 0.0;
+  for(size_t k = 0; k < lanes; k++) s += acc0[k];
+  for(; i < n; i++) s += a[i];
+  return s;
+}
+
+inline double dot(const double* a, const double* b, size_t n) {
+  vec acc0 = broadcast(0.0);
+  vec acc1 = acc0;
+  size_t i = 0;
+  for(; i + 2*lanes <= n; i += 2*lanes) {
+    acc0 += load(a + i) * load(b + i);
+    acc1 += load(a + i + lanes) * load(b + i + lanes);
+  }
+  acc0 += acc1;
+  double s = 0.0;
+  for(size_t k = 0; k < lanes; k++) s += acc0[k];
+  for(; i < n; i++) s += a[i] * b[i];
+  return s;
+}
+
+/// Reduces a non-empty array with min or max
+template<numeric_op Op>
+double reduce(const double* a, size_t n) {
+  size_t i = 0;
+  double r = a[0];
+  if(n >= lanes) {
+    vec acc = load(a);
+    for(i = lanes; i + lanes <= n; i += lanes)
+      acc = apply<Op>(acc, load(a + i));
+    for(size_t k = 0; k < lanes; k++)
+      r = scalar::apply<Op>(r, acc[k]);
+  }
+  for(; i < n; i++) r = scalar::apply<Op>(r, a[i]);
+  return r;
+}
+
+}
@@ -0,0 +1,578 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_NUMERIC_VECTOR_H_
+#define MRBIND17_NUMERIC_VECTOR_H_
+
+#include <mrbind17/module.hpp>
+#include <mrbind17/class.hpp>
+#include <mrbind17/instance.hpp>
+#include <mrbind17/type_binder.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace mrbind17 {
+
+/**
+ * Instruction set used by the numeric_vector kernels.
+ * - scalar: plain loops;
+ * - vector: 128-bit vectors (SSE2 on x86-64, NEON on ARM64, etc.);
+ * - avx2: 256-bit AVX2 vectors, selected at runtime if the CPU supports them.
+ */
+enum class simd_level { scalar, vector, avx2 };
+
+namespace detail {
+
+enum class numeric_op { add, sub, mul, div, min, max, lt, le, gt, ge, eq };
+
+/// Scalar implementation of the numeric kernels, used as a fallback
+/// and to process the elements that do not fill a whole vector.
+namespace scalar {
+
+template<numeric_op Op>
+inline double apply(double a, double b) {
+  if constexpr (Op == numeric_op::add) return a + b;
+  if constexpr (Op == numeric_op::sub) return a - b;
+  if constexpr (Op == numeric_op::mul) return a * b;
+  if constexpr (Op == numeric_op::div) return a / b;
+  if constexpr (Op == numeric_op::min) return a < b ? a : b;
+  if constexpr (Op == numeric_op::max) return a > b ? a : b;
+  if constexpr (Op == numeric_op::lt)  return a <  b ? 1.0 : 0.0;
+  if constexpr (Op == numeric_op::le)  return a <= b ? 1.0 : 0.0;
+  if constexpr (Op == numeric_op::gt)  return a >  b ? 1.0 : 0.0;
+  if constexpr (Op == numeric_op::ge)  return a >= b ? 1.0 : 0.0;
+  if constexpr (Op == numeric_op::eq)  return a == b ? 1.0 : 0.0;
+}
+
+template<numeric_op Op>
+void map(const double* a, const double* b, double* out, size_t n) {
+  for(size_t i = 0; i < n; i++) out[i] = apply<Op>(a[i], b[i]);
+}
+
+template<numeric_op Op>
+void map_scalar(const double* a, double s, double* out, size_t n) {
+  for(size_t i = 0; i < n; i++) out[i] = apply<Op>(a[i], s);
+}
+
+inline void clamp(const double* a, double lo, double hi, double* out, size_t n) {
+  for(size_t i = 0; i < n; i++)
+    out[i] = apply<numeric_op::min>(apply<numeric_op::max>(a[i], lo), hi);
+}
+
+inline double sum(const double* a, size_t n) {
+  double s = 0.0;
+  for(size_t i = 0; i < n; i++) s += a[i];
+  return s;
+}
+
+inline double dot(const double* a, const double* b, size_t n) {
+  double s = 0.0;
+  for(size_t i = 0; i < n; i++) s += a[i] * b[i];
+  return s;
+}
+
+template<numeric_op Op>
+double reduce(const double* a, size_t n) {
+  double r = a[0];
+  for(size_t i = 1; i < n; i++) r = apply<Op>(r, a[i]);
+  return r;
+}
+
+} // namespace scalar
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#define MRBIND17_HAS_VECTOR_KERNELS
+
+#define MRBIND17_SIMD_NAMESPACE simd_vector
+#define MRBIND17_SIMD_BYTES 16
+#include <mrbind17/numeric_kernels.hpp>
+#undef MRBIND17_SIMD_NAMESPACE
+#undef MRBIND17_SIMD_BYTES
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define MRBIND17_HAS_AVX2_KERNELS
+
+// Everything in simd_avx2 is compiled for AVX2 regardless of the flags
+// of the including translation unit; it is only called after checking
+// that the CPU supports AVX2.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to=function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#define MRBIND17_SIMD_NAMESPACE simd_avx2
+#define MRBIND17_SIMD_BYTES 32
+#include <mrbind17/numeric_kernels.hpp>
+#undef MRBIND17_SIMD_NAMESPACE
+#undef MRBIND17_SIMD_BYTES
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // x86
+
+#endif // GCC or Clang
+
+/// Returns the best instruction set supported by both the compiler and the CPU
+inline simd_level detect_simd_level() {
+#if defined(MRBIND17_HAS_AVX2_KERNELS)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return simd_level::avx2;
+#endif
+#if defined(MRBIND17_HAS_VECTOR_KERNELS)
+  return simd_level::vector;
+#else
+  return simd_level::scalar;
+#endif
+}
+
+inline simd_level& active_simd_level() {
+  static simd_level level = detect_simd_level();
+  return level;
+}
+
+#if defined(MRBIND17_HAS_AVX2_KERNELS)
+#define MRBIND17_DISPATCH_AVX2(call) case simd_level::avx2: return simd_avx2::call;
+#else
+#define MRBIND17_DISPATCH_AVX2(call)
+#endif
+
+#if defined(MRBIND17_HAS_VECTOR_KERNELS)
+#define MRBIND17_DISPATCH_VECTOR(call) case simd_level::vector: return simd_vector::call;
+#else
+#define MRBIND17_DISPATCH_VECTOR(call)
+#endif
+
+/// Calls the kernel matching the active instruction set
+#define MRBIND17_DISPATCH(call)          \
+  switch(active_simd_level()) {          \
+    MRBIND17_DISPATCH_AVX2(call)         \
+    MRBIND17_DISPATCH_VECTOR(call)       \
+    default: return scalar::call;        \
+  }
+
+template<numeric_op Op>
+void numeric_map(const double* a, const double* b, double* out, size_t n) {
+  MRBIND17_DISPATCH(template map<Op>(a, b, out, n))
+}
+
+template<numeric_op Op>
+void numeric_map_scalar(const double* a, double s, double* out, size_t n) {
+  MRBIND17_DISPATCH(template map_scalar<Op>(a, s, out, n))
+}
+
+inline void numeric_clamp(const double* a, double lo, double hi, double* out, size_t n) {
+  MRBIND17_DISPATCH(clamp(a, lo, hi, out, n))
+}
+
+inline double numeric_sum(const double* a, size_t n) {
+  MRBIND17_DISPATCH(sum(a, n))
+}
+
+inline double numeric_dot(const double* a, const double* b, size_t n) {
+  MRBIND17_DISPATCH(dot(a, b, n))
+}
+
+template<numeric_op Op>
+double numeric_reduce(const double* a, size_t n) {
+  MRBIND17_DISPATCH(template reduce<Op>(a, n))
+}
+
+#undef MRBIND17_DISPATCH
+#undef MRBIND17_DISPATCH_AVX2
+#undef MRBIND17_DISPATCH_VECTOR
+
+} // namespace detail
+
+/**
+ * @brief The numeric_vector class is a contiguous array of doubles
+ * whose bulk operations (elementwise arithmetic, reductions, clamping
+ * and comparisons) run in SIMD kernels selected at runtime for the
+ * host CPU. It can be exposed to Ruby with def_numeric_vector, so that
+ * scripts can express per-element computations without running the
+ * inner loop in the VM.
+ *
+ * Comparisons produce masks, i.e. vectors of 1.0 (true) and 0.0 (false),
+ * which can be combined with multiplication and summed to count matches.
+ */
+class numeric_vector {
+
+  public:
+
+  numeric_vector() = default;
+
+  explicit numeric_vector(size_t size, double fill = 0.0)
+  : m_data(size, fill) {}
+
+  numeric_vector(const double* data, size_t size)
+  : m_data(data, data + size) {}
+
+  numeric_vector(std::vector<double> data)
+  : m_data(std::move(data)) {}
+
+  numeric_vector(std::initializer_list<double> data)
+  : m_data(data) {}
+
+  template<typename Iterator,
+           typename = std::enable_if_t<!std::is_arithmetic<Iterator>::value>>
+  numeric_vector(Iterator begin, Iterator end)
+  : m_data(begin, end) {}
+
+  size_t size() const { return m_data.size(); }
+
+  bool empty() const { return m_data.empty(); }
+
+  double* data() { return m_data.data(); }
+
+  const double* data() const { return m_data.data(); }
+
+  double& operator[](size_t i) { return m_data[i]; }
+
+  const double& operator[](size_t i) const { return m_data[i]; }
+
+  auto begin() { return m_data.begin(); }
+
+  auto end() { return m_data.end(); }
+
+  auto begin() const { return m_data.begin(); }
+
+  auto end() const { return m_data.end(); }
+
+  const std::vector<double>& values() const { return m_data; }
+
+  numeric_vector operator+(const numeric_vector& v) const { return map<detail::numeric_op::add>(v); }
+  numeric_vector operator-(const numeric_vector& v) const { return map<detail::numeric_op::sub>(v); }
+  numeric_vector operator*(const numeric_vector& v) const { return map<detail::numeric_op::mul>(v); }
+  numeric_vector operator/(const numeric_vector& v) const { return map<detail::numeric_op::div>(v); }
+
+  numeric_vector operator+(double s) const { return map<detail::numeric_op::add>(s); }
+  numeric_vector operator-(double s) const { return map<detail::numeric_op::sub>(s); }
+  numeric_vector operator*(double s) const { return map<detail::numeric_op::mul>(s); }
+  numeric_vector operator/(double s) const { return map<detail::numeric_op::div>(s); }
+
+  numeric_vector scale(double s) const { return map<detail::numeric_op::mul>(s); }
+
+  numeric_vector lt(const numeric_vector& v) const { return map<detail::numeric_op::lt>(v); }
+  numeric_vector le(const numeric_vector& v) const { return map<detail::numeric_op::le>(v); }
+  numeric_vector gt(const numeric_vector& v) const { return map<detail::numeric_op::gt>(v); }
+  numeric_vector ge(const numeric_vector& v) const { return map<detail::numeric_op::ge>(v); }
+  numeric_vector eq(const numeric_vector& v) const { return map<detail::numeric_op::eq>(v); }
+
+  numeric_vector lt(double s) const { return map<detail::numeric_op::lt>(s); }
+  numeric_vector le(double s) const { return map<detail::numeric_op::le>(s); }
+  numeric_vector gt(double s) const { return map<detail::numeric_op::gt>(s); }
+  numeric_vector ge(double s) const { return map<detail::numeric_op::ge>(s); }
+  numeric_vector eq(double s) const { return map<detail::numeric_op::eq>(s); }
+
+  numeric_vector clamp(double lo, double hi) const {
+    numeric_vector result(size());
+    detail::numeric_clamp(data(), lo, hi, result.data(), size());
+    return result;
+  }
+
+  double sum() const {
+    return detail::numeric_sum(data(), size());
+  }
+
+  double dot(const numeric_vector& v) const {
+    check_size(v);
+    return detail::numeric_dot(data(), v.data(), size());
+  }
+
+  /**
+   * @brief Returns the smallest element. Throws std::out_of_range
+   * if the vector is empty.
+   */
+  double min() const {
+    if(empty()) throw std::out_of_range("min() called on an empty numeric_vector");
+    return detail::numeric_reduce<detail::numeric_op::min>(data(), size());
+  }
+
+  /**
+   * @brief Returns the largest element. Throws std::out_of_range
+   * if the vector is empty.
+   */
+  double max() const {
+    if(empty()) throw std::out_of_range("max() called on an empty numeric_vector");
+    return detail::numeric_reduce<detail::numeric_op::max>(data(), size());
+  }
+
+  /**
+   * @brief Returns the instruction set used by the kernels.
+   */
+  static simd_level active_simd_level() {
+    return detail::active_simd_level();
+  }
+
+  /**
+   * @brief Selects the instruction set used by the kernels (e.g. to
+   * compare against the scalar fallback). Levels not supported by the
+   * compiler or the CPU are lowered to the best supported one.
+   */
+  static void set_simd_level(simd_level level) {
+    auto best = detail::detect_simd_level();
+    detail::active_simd_level() = level < best ? level : best;
+  }
+
+  template<detail::numeric_op Op>
+  numeric_vector map(const numeric_vector& v) const {
+    check_size(v);
+    numeric_vector result(size());
+    detail::numeric_map<Op>(data(), v.data(), result.data(), size());
+    return result;
+  }
+
+  template<detail::numeric_op Op>
+  numeric_vector map(double s) const {
+    numeric_vector result(size());
+    detail::numeric_map_scalar<Op>(data(), s, result.data(), size());
+    return result;
+  }
+
+  private:
+
+  void check_size(const numeric_vector& v) const {
+    if(v.size() != size())
+      throw std::invalid_argument("numeric_vector sizes do not match");
+  }
+
+  std::vector<double> m_data;
+};
+
+namespace detail {
+
+/// numeric_vector uses the generic wrapper of bound classes,
+/// but also accepts Ruby arrays of numbers. Parameters taken by
+/// reference refer to the wrapped vector; an Array is converted into
+/// a temporary vector, which a non-const reference modifies instead
+/// of the Array.
+template<typename Vector>
+struct type_binder<Vector, std::enable_if_t<std::is_same<std::decay_t<Vector>, numeric_vector>::value>> {
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, numeric_vector v) {
+    return wrap_instance<numeric_vector>(mrb, new numeric_vector(std::move(v)), true);
+  }
+
+  static numeric_vector mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    if(auto v = get_instance<numeric_vector>(mrb, val)) return *v;
+    numeric_vector result(RARRAY_LEN(val));
+    for(size_t i = 0; i < result.size(); i++)
+      result[i] = type_binder<double>::mrb_to_cpp(mrb, RARRAY_PTR(val)[i]);
+    return result;
+  }
+
+  static numeric_vector* convert_ref(mrb_state* mrb, mrb_value val, std::optional<numeric_vector>& holder) {
+    if(auto v = get_instance<numeric_vector>(mrb, val)) return v;
+    if(!check_type(mrb, val)) return nullptr;
+    holder.emplace(mrb_to_cpp(mrb, val));
+    return &*holder;
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    if(get_instance<numeric_vector>(mrb, val)) return true;
+    if(!mrb_array_p(val)) return false;
+    for(mrb_int i = 0; i < RARRAY_LEN(val); i++)
+      if(!type_binder<double>::check_type(mrb, RARRAY_PTR(val)[i])) return false;
+    return true;
+  }
+
+};
+
+inline numeric_vector& numeric_vector_self(mrb_state* mrb, mrb_value self) {
+  auto v = get_instance<numeric_vector>(mrb, self);
+  if(!v) mrb_raise(mrb, E_TYPE_ERROR, "uninitialized NumericVector");
+  return *v;
+}
+
+/// Converts a method argument into a numeric_vector pointer, or returns
+/// nullptr if the argument is a number (stored in scalar).
+inline const numeric_vector* numeric_vector_operand(mrb_state* mrb, mrb_value arg, double& scalar) {
+  if(auto v = get_instance<numeric_vector>(mrb, arg)) return v;
+  if(!type_binder<double>::check_type(mrb, arg))
+    raise_invalid_type(mrb, 0, "NumericVector or number", arg);
+  scalar = type_binder<double>::mrb_to_cpp(mrb, arg);
+  return nullptr;
+}
+
+inline mrb_value wrap_numeric_vector(mrb_state* mrb, numeric_vector&& v) {
+  return wrap_instance<numeric_vector>(mrb, new numeric_vector(std::move(v)), true);
+}
+
+inline void check_numeric_vector_sizes(mrb_state* mrb, const numeric_vector& a, const numeric_vector& b) {
+  if(a.size() != b.size())
+    mrb_raisef(mrb, E_ARGUMENT_ERROR, "NumericVector sizes do not match (%S and %S)",
+               mrb_fixnum_value(a.size()), mrb_fixnum_value(b.size()));
+}
+
+template<numeric_op Op>
+mrb_value numeric_vector_map(mrb_state* mrb, mrb_value self) {
+  mrb_value arg;
+  mrb_get_args(mrb, "o", &arg);
+  const numeric_vector& v = numeric_vector_self(mrb, self);
+  double s = 0.0;
+  const numeric_vector* other = numeric_vector_operand(mrb, arg, s);
+  if(other) {
+    check_numeric_vector_sizes(mrb, v, *other);
+    return wrap_numeric_vector(mrb, v.map<Op>(*other));
+  }
+  return wrap_numeric_vector(mrb, v.map<Op>(s));
+}
+
+inline mrb_value numeric_vector_initialize(mrb_state* mrb, mrb_value self) {
+  mrb_value arg = mrb_nil_value();
+  mrb_float fill = 0.0;
+  mrb_get_args(mrb, "|of", &arg, &fill);
+  if(!mrb_nil_p(arg)
+  && !mrb_fixnum_p(arg)
+  && !type_binder<numeric_vector>::check_type(mrb, arg))
+    raise_invalid_type(mrb, 0, "Array of numbers, Integer or NumericVector", arg);
+  if(mrb_fixnum_p(arg) && mrb_fixnum(arg) < 0)
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "negative NumericVector size");
+  auto inst = new instance<numeric_vector>{ nullptr, true };
+  if(mrb_nil_p(arg))
+    inst->ptr = new numeric_vector();
+  else if(mrb_fixnum_p(arg))
+    inst->ptr = new numeric_vector(mrb_fixnum(arg), fill);
+  else
+    inst->ptr = new numeric_vector(type_binder<numeric_vector>::mrb_to_cpp(mrb, arg));
+  auto previous = DATA_PTR(self);
+  mrb_data_init(self, inst, &instance_type<numeric_vector>::datatype);
+  if(previous) delete_instance<numeric_vector>(mrb, previous);
+  return self;
+}
+
+inline mrb_value numeric_vector_size(mrb_state* mrb, mrb_value self) {
+  return mrb_fixnum_value(numeric_vector_self(mrb, self).size());
+}
+
+inline mrb_int numeric_vector_index(mrb_state* mrb, const numeric_vector& v, mrb_int i) {
+  mrb_int size = v.size();
+  if(i < 0) i += size;
+  if(i < 0 || i >= size)
+    mrb_raisef(mrb, E_INDEX_ERROR, "index %S outside of NumericVector of size %S",
+               mrb_fixnum_value(i), mrb_fixnum_value(size));
+  return i;
+}
+
+inline mrb_value numeric_vector_get(mrb_state* mrb, mrb_value self) {
+  mrb_int i;
+  mrb_get_args(mrb, "i", &i);
+  auto& v = numeric_vector_self(mrb, self);
+  return mrb_float_value(mrb, v[numeric_vector_index(mrb, v, i)]);
+}
+
+inline mrb_value numeric_vector_set(mrb_state* mrb, mrb_value self) {
+  mrb_int i;
+  mrb_float x;
+  mrb_get_args(mrb, "if", &i, &x);
+  auto& v = numeric_vector_self(mrb, self);
+  v[numeric_vector_index(mrb, v, i)] = x;
+  return mrb_float_value(mrb, x);
+}
+
+inline mrb_value numeric_vector_to_a(mrb_state* mrb, mrb_value self) {
+  auto& v = numeric_vector_self(mrb, self);
+  mrb_value array = mrb_ary_new_capa(mrb, v.size());
+  for(double x : v) mrb_ary_push(mrb, array, mrb_float_value(mrb, x));
+  return array;
+}
+
+inline mrb_value numeric_vector_sum(mrb_state* mrb, mrb_value self) {
+  return mrb_float_value(mrb, numeric_vector_self(mrb, self).sum());
+}
+
+inline mrb_value numeric_vector_dot(mrb_state* mrb, mrb_value self) {
+  mrb_value arg;
+  mrb_get_args(mrb, "o", &arg);
+  auto& v = numeric_vector_self(mrb, self);
+  auto other = get_instance<numeric_vector>(mrb, arg);
+  if(!other) raise_invalid_type(mrb, 0, "NumericVector", arg);
+  check_numeric_vector_sizes(mrb, v, *other);
+  return mrb_float_value(mrb, v.dot(*other));
+}
+
+template<numeric_op Op>
+mrb_value numeric_vector_reduce(mrb_state* mrb, mrb_value self) {
+  auto& v = numeric_vector_self(mrb, self);
+  if(v.empty()) return mrb_nil_value();
+  return mrb_float_value(mrb, numeric_reduce<Op>(v.data(), v.size()));
+}
+
+inline mrb_value numeric_vector_scale(mrb_state* mrb, mrb_value self) {
+  mrb_float s;
+  mrb_get_args(mrb, "f", &s);
+  return wrap_numeric_vector(mrb, numeric_vector_self(mrb, self).scale(s));
+}
+
+inline mrb_value numeric_vector_clamp(mrb_state* mrb, mrb_value self) {
+  mrb_float lo, hi;
+  mrb_get_args(mrb, "ff", &lo, &hi);
+  return wrap_numeric_vector(mrb, numeric_vector_self(mrb, self).clamp(lo, hi));
+}
+
+} // namespace detail
+
+/**
+ * @brief Exposes numeric_vector as a Ruby class in the given module.
+ *
+ * In Ruby, NumericVector.new accepts an Array of numbers, another
+ * NumericVector, or a size and an optional fill value. Instances
+ * provide size, [], []=, to_a, +, -, *, / (with a vector or a number),
+ * sum, dot, min, max, scale, clamp, and the lt, le, gt, ge and eq
+ * comparisons returning masks.
+ *
+ * @param mod Module in which to define the class.
+ * @param name Name of the class.
+ *
+ * @return The class object.
+ */
+inline class_<numeric_vector> def_numeric_vector(module& mod, const char* name = "NumericVector") {
+  using namespace detail;
+  auto cls = mod.def_class<numeric_vector>(name);
+  mrb_state* mrb = cls.mrb();
+  RClass* c = cls.rclass();
+  mrb_define_method(mrb, c, "initialize", numeric_vector_initialize, MRB_ARGS_OPT(2));
+  mrb_define_method(mrb, c, "size",   numeric_vector_size,   MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "length", numeric_vector_size,   MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "[]",     numeric_vector_get,    MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "[]=",    numeric_vector_set,    MRB_ARGS_REQ(2));
+  mrb_define_method(mrb, c, "to_a",   numeric_vector_to_a,   MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "+",      numeric_vector_map<numeric_op::add>, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "-",      numeric_vector_map<numeric_op::sub>, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "*",      numeric_vector_map<numeric_op::mul>, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "/",      numeric_vector_map<numeric_op::div>, MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "lt",     numeric_vector_map<numeric_op::lt>,  MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "le",     numeric_vector_map<numeric_op::le>,  MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "gt",     numeric_vector_map<numeric_op::gt>,  MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "ge",     numeric_vector_map<numeric_op::ge>,  MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "eq",     numeric_vector_map<numeric_op::eq>,  MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "sum",    numeric_vector_sum,    MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "dot",    numeric_vector_dot,    MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "min",    numeric_vector_reduce<numeric_op::min>, MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "max",    numeric_vector_reduce<numeric_op::max>, MRB_ARGS_NONE());
+  mrb_define_method(mrb, c, "scale",  numeric_vector_scale,  MRB_ARGS_REQ(1));
+  mrb_define_method(mrb, c, "clamp",  numeric_vector_clamp,  MRB_ARGS_REQ(2));
+  return cls;
+}
+
+}
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_PROFILER_H_
+#define MRBIND17_PROFILER_H_
+
+#include <mrbind17/interpreter.hpp>
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <mruby/debug.h>
+#include <mruby/irep.h>
+#include <mruby/proc.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace mrbind17 {
+
+/**
+ * @brief The profiler periodically samples the call stack of an
+ * interpreter while it is running, and aggregates the samples by stack.
+ *
+ * A timer thread marks a sample as pending at each interval; the stack
+ * is then recorded by the interpreter's thread at the next instruction
+ * fetched by the VM, or when the bound C++ function being executed
+ * returns. Time spent in a bound function is therefore attributed to a
+ * frame bearing the function's name.
+ *
+ * Ruby frames are named after their method ("<main>" for top-level
+ * code) followed by the file and line being executed, when the script
+ * was compiled with debug information.
+ *
+ * Sampling Ruby code relies on MRuby's code fetch hook, which requires
+ * MRuby and the application to be compiled with MRB_ENABLE_DEBUG_HOOK.
+ * Without it, start() throws std::runtime_error.
+ *
+ * Memory use is bounded: at most max_stacks distinct stacks are kept,
+ * samples of further stacks are aggregated under "[other]", and stacks
+ * deeper than max_depth keep only their innermost frames.
+ *
+ * The profiler must be destroyed before the interpreter it profiles.
+ */
+class profiler : private detail::sampler {
+
+  public:
+
+  /**
+   * @brief Constructor. The profiler is not started.
+   *
+   * @param interp Interpreter to profile.
+   * @param interval Sampling interval.
+   * @param max_stacks Maximum number of distinct stacks recorded.
+   * @param max_depth Maximum number of frames recorded per stack.
+   */
+  explicit profiler(interpreter& interp,
+                    std::chrono::microseconds interval = std::chrono::milliseconds(1),
+                    size_t max_stacks = 10000,
+                    size_t max_depth = 128)
+  : m_mrb(interp.mrb())
+  , m_interval(interval)
+  , m_max_stacks(max_stacks)
+  , m_max_depth(max_depth) {}
+
+  profiler(const profiler&) = delete;
+  profiler& operator=(const profiler&) = delete;
+
+  /**
+   * @brief The destructor stops the profiler if it is running.
+   */
+  ~profiler() {
+    stop();
+  }
+
+  /**
+   * @brief Starts sampling. Only one profiler can be active on
+   * an interpreter at any time.
+   */
+  void start() {
+#ifdef MRB_ENABLE_DEBUG_HOOK
+    if(m_running) return;
+    auto s = detail::get_state(m_mrb);
+    if(!s) throw std::runtime_error("Interpreter has no C++ state attached");
+    if(s->active_sampler) throw std::runtime_error("Another profiler is active on this interpreter");
+    s->active_sampler = this;
+    m_previous_hook = m_mrb->code_fetch_hook;
+    m_mrb->code_fetch_hook = &profiler::code_fetch_hook;
+    m_stop = false;
+    m_running = true;
+    m_timer = std::thread([this]() { run_timer(); });
+#else
+    throw std::runtime_error("Profiling requires MRuby to be built with MRB_ENABLE_DEBUG_HOOK");
+#endif
+  }
+
+  /**
+   * @brief Stops sampling. Samples pending at this point are dropped.
+   */
+  void stop() {
+#ifdef MRB_ENABLE_DEBUG_HOOK
+    if(!m_running) return;
+    {
+      std::lock_guard<std::mutex> lock(m_timer_mutex);
+      m_stop = true;
+    }
+    m_timer_cv.notify_one();
+    m_timer.join();
+    m_mrb->code_fetch_hook = m_previous_hook;
+    detail::get_state(m_mrb)->active_sampler = nullptr;
+    pending = 0;
+    m_running = false;
+#endif
+  }
+
+  bool running() const {
+    return m_running;
+  }
+
+  /**
+   * @brief Returns the total number of samples recorded.
+   */
+  size_t samples() const {
+    std::lock_guard<std::mutex> lock(m_stacks_mutex);
+    return m_samples;
+  }
+
+  /**
+   * @brief Discards the samples recorded so far.
+   */
+  void reset() {
+    std::lock_guard<std::mutex> lock(m_stacks_mutex);
+    m_stacks.clear();
+    m_samples = 0;
+  }
+
+  /**
+   * @brief Writes the samples in the collapsed stack format, one line
+   * per stack: frames from outermost to innermost separated by ';',
+   * followed by a space and the number of samples. This format is
+   * understood by flamegraph.pl, speedscope, inferno, etc.
+   */
+  void write_collapsed(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(m_stacks_mutex);
+    for(const auto& [stack, count] : m_stacks)
+      os << stack << ' ' << count << '\n';
+  }
+
+  std::string collapsed() const {
+    std::ostringstream ss;
+    write_collapsed(ss);
+    return ss.str();
+  }
+
+  private:
+
+  mrb_state*                m_mrb;
+  std::chrono::microseconds m_interval;
+  size_t                    m_max_stacks;
+  size_t                    m_max_depth;
+  bool                      m_running = false;
+
+  std::thread               m_timer;
+  std::mutex                m_timer_mutex;
+  std::condition_variable   m_timer_cv;
+  bool                      m_stop = false;
+
+  mutable std::mutex                      m_stacks_mutex;
+  std::unordered_map<std::string, size_t> m_stacks;
+  size_t                                  m_samples = 0;
+  std::string                             m_buffer;
+
+#ifdef MRB_ENABLE_DEBUG_HOOK
+  void (*m_previous_hook)(mrb_state*, mrb_irep*, const mrb_code*, mrb_value*) = nullptr;
+
+  static void code_fetch_hook(mrb_state* mrb, mrb_irep* irep, const mrb_code* pc, mrb_value* regs) {
+    auto self = static_cast<profiler*>(detail::get_state(mrb)->active_sampler);
+    if(self->pending.load(std::memory_order_relaxed) != 0)
+      self->take_samples(mrb, pc);
+    if(self->m_previous_hook)
+      self->m_previous_hook(mrb, irep, pc, regs);
+  }
+#endif
+
+  void run_timer() {
+    std::unique_lock<std::mutex> lock(m_timer_mutex);
+    auto next = std::chrono::steady_clock::now() + m_interval;
+    while(!m_timer_cv.wait_until(lock, next, [this]() { return m_stop; })) {
+      pending.fetch_add(1, std::memory_order_relaxed);
+      next += m_interval;
+    }
+  }
+
+  void take_samples(mrb_state* mrb, const mrb_code* pc) override {
+    unsigned n = pending.exchange(0, std::memory_order_relaxed);
+    if(n == 0) return;
+    mrb_callinfo* top   = mrb->c->ci;
+    mrb_callinfo* first = mrb->c->cibase;
+    m_buffer.clear();
+    if(static_cast<size_t>(top - first) >= m_max_depth) {
+      first = top - m_max_depth + 1;
+      m_buffer += "...";
+    }
+    for(mrb_callinfo* ci = first; ci <= top; ci++) {
+      // the current instruction of a caller is the one before the
+      // return address stored in the frame of its callee
+      const mrb_code* frame_pc = (ci == top) ? pc : (ci+1)->pc;
+      if(frame_pc && ci != top) frame_pc -= 1;
+      append_frame(mrb, ci, frame_pc);
+    }
+    std::lock_guard<std::mutex> lock(m_stacks_mutex);
+    m_samples += n;
+    auto it = m_stacks.find(m_buffer);
+    if(it != m_stacks.end())
+      it->second += n;
+    else if(m_stacks.size() < m_max_stacks)
+      m_stacks.emplace(m_buffer, n);
+    else
+      m_stacks["[other]"] += n;
+  }
+
+  void append_frame(mrb_state* mrb, mrb_callinfo* ci, const mrb_code* pc) {
+    if(!m_buffer.empty()) m_buffer += ';';
+    mrb_int len = 0;
+    const char* name = ci->mid ? mrb_sym2name_len(mrb, ci->mid, &len) : nullptr;
+    if(name) m_buffer.append(name, len);
+    else m_buffer += "<main>";
+    struct RProc* proc = ci->proc;
+    if(!proc || MRB_PROC_CFUNC_P(proc) || !pc) return;
+    mrb_irep* irep = proc->body.irep;
+    if(pc < irep->iseq || pc >= irep->iseq + irep->ilen) return;
+    ptrdiff_t offset = pc - irep->iseq;
+    const char* file = mrb_debug_get_filename(mrb, irep, offset);
+    int32_t     line = mrb_debug_get_line(mrb, irep, offset);
+    if(line < 0) return;
+    m_buffer += " (";
+    m_buffer += file ? file : "-";
+    m_buffer += ':';
+    m_buffer += std::to_string(line);
+    m_buffer += ')';
+  }
+
+};
+
+}
+
+#endif
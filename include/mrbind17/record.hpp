@@ -0,0 +1,351 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_RECORD_H_
+#define MRBIND17_RECORD_H_
+
+#include <mrbind17/type_binder.hpp>
+#include <mrbind17/state.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/hash.h>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mrbind17 {
+
+/**
+ * @brief Field of a record: its name in Ruby and a pointer to member.
+ */
+template<typename T, typename M>
+struct record_field {
+  const char* name;
+  M T::*      member;
+};
+
+template<typename T, typename M>
+constexpr record_field<T, M> field(const char* name, M T::* member) {
+  return { name, member };
+}
+
+/**
+ * @brief Describes a plain aggregate T converted to and from Ruby field
+ * by field. Specializations provide a tuple of record_field:
+ *
+ *   template<> struct mrbind17::record_traits<point> {
+ *     static constexpr auto fields = std::make_tuple(
+ *       mrbind17::field("x", &point::x),
+ *       mrbind17::field("y", &point::y));
+ *   };
+ *
+ * or equivalently MRBIND17_RECORD(point, x, y). A record is converted
+ * into a Hash with symbol keys, or into an instance of the Struct class
+ * defined with module::def_record; both are accepted back, missing hash
+ * keys leaving the corresponding fields default-initialized. Fields may
+ * be records, std::vector, std::map or std::unordered_map (converted
+ * into arrays and hashes), or any other type with a type_binder.
+ */
+template<typename T>
+struct record_traits {};
+
+#define MRBIND17_RECORD_FIELD_(T, name) ::mrbind17::field(#name, &T::name)
+#define MRBIND17_RECORD_CAT_(a, b) MRBIND17_RECORD_CAT2_(a, b)
+#define MRBIND17_RECORD_CAT2_(a, b) a##b
+#define MRBIND17_RECORD_COUNT_(...) MRBIND17_RECORD_COUNT2_(__VA_ARGS__, \
+  16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define MRBIND17_RECORD_COUNT2_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, \
+  _11, _12, _13, _14, _15, _16, N, ...) N
+#define MRBIND17_RECORD_MAP_1(T, a) MRBIND17_RECORD_FIELD_(T, a)
+#define MRBIND17_RECORD_MAP_2(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_1(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_3(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_2(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_4(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_3(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_5(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_4(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_6(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_5(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_7(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_6(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_8(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_7(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_9(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_8(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_10(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_9(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_11(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_10(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_12(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_11(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_13(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_12(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_14(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_13(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_15(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_14(T, __VA_ARGS__)
+#define MRBIND17_RECORD_MAP_16(T, a, ...) MRBIND17_RECORD_FIELD_(T, a), MRBIND17_RECORD_MAP_15(T, __VA_ARGS__)
+
+/**
+ * @brief Specializes record_traits for T from the names of its fields
+ * (at most 16). Must be used at global scope.
+ */
+#define MRBIND17_RECORD(T, ...)                                              \
+  template<> struct mrbind17::record_traits<T> {                             \
+    static constexpr auto fields = std::make_tuple(                          \
+      MRBIND17_RECORD_CAT_(MRBIND17_RECORD_MAP_, MRBIND17_RECORD_COUNT_(__VA_ARGS__))(T, __VA_ARGS__)); \
+  }
+
+namespace detail {
+
+template<typename T, typename = void>
+struct is_record : std::false_type {};
+
+template<typename T>
+struct is_record<T, std::void_t<decltype(record_traits<T>::fields)>> : std::true_type {};
+
+template<typename T>
+constexpr size_t record_size = std::tuple_size<std::decay_t<decltype(record_traits<T>::fields)>>::value;
+
+/// Returns the table of the record type T, interning the names
+/// of its fields the first time.
+template<typename T>
+record_table& get_record_table(mrb_state* mrb) {
+  auto s = get_state(mrb);
+  if(!s) throw std::runtime_error("Records require a state created by an interpreter");
+  size_t index = record_type_index<T>();
+  if(index >= s->record_tables.size()) s->record_tables.resize(index+1);
+  auto& table = s->record_tables[index];
+  if(!table) {
+    auto t = std::make_unique<record_table>();
+    std::apply([&](const auto&... f) {
+      (t->fields.push_back(mrb_intern_static(mrb, f.name, std::strlen(f.name))), ...);
+    }, record_traits<T>::fields);
+    table = std::move(t);
+  }
+  return *table;
+}
+
+/// Binder used for the fields of records: containers are converted
+/// element by element, other types use their type_binder.
+template<typename F, typename = void>
+struct field_binder : type_binder<F> {};
+
+/// Converts val with the binder of F, in one pass if it supports it.
+template<typename F>
+bool field_from_mrb(mrb_state* mrb, mrb_value val, F& out) {
+  using binder = field_binder<F>;
+  if constexpr (has_try_convert<binder, F>::value) {
+    std::optional<F> tmp;
+    if(!binder::try_convert(mrb, val, tmp)) return false;
+    out = std::move(*tmp);
+  } else {
+    if(!binder::check_type(mrb, val)) return false;
+    out = binder::mrb_to_cpp(mrb, val);
+  }
+  return true;
+}
+
+template<typename F>
+bool field_check_type(mrb_state* mrb, mrb_value val) {
+  std::optional<F> tmp;
+  return field_binder<F>::try_convert(mrb, val, tmp);
+}
+
+template<typename F>
+F field_to_cpp(mrb_state* mrb, mrb_value val) {
+  std::optional<F> tmp;
+  if(!field_binder<F>::try_convert(mrb, val, tmp))
+    throw std::invalid_argument("Cannot convert " + get_cpp_class_name<F>(mrb));
+  return std::move(*tmp);
+}
+
+template<typename E, typename A>
+struct field_binder<std::vector<E, A>> {
+
+  using vector_type = std::vector<E, A>;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const vector_type& v) {
+    mrb_value ary = mrb_ary_new_capa(mrb, static_cast<mrb_int>(v.size()));
+    int ai = mrb_gc_arena_save(mrb);
+    for(const auto& e : v) {
+      mrb_ary_push(mrb, ary, field_binder<E>::cpp_to_mrb(mrb, e));
+      mrb_gc_arena_restore(mrb, ai);
+    }
+    return ary;
+  }
+
+  static bool try_convert(mrb_state* mrb, mrb_value val, std::optional<vector_type>& out) {
+    if(!mrb_array_p(val)) return false;
+    vector_type v(RARRAY_LEN(val));
+    for(mrb_int i = 0; i < RARRAY_LEN(val); i++)
+      if(!field_from_mrb(mrb, RARRAY_PTR(val)[i], v[i])) return false;
+    out.emplace(std::move(v));
+    return true;
+  }
+
+  static vector_type mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return field_to_cpp<vector_type>(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return field_check_type<vector_type>(mrb, val);
+  }
+
+};
+
+template<typename Map>
+struct map_field_binder {
+
+  using key_type    = typename Map::key_type;
+  using mapped_type = typename Map::mapped_type;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const Map& m) {
+    mrb_value hash = mrb_hash_new_capa(mrb, static_cast<mrb_int>(m.size()));
+    int ai = mrb_gc_arena_save(mrb);
+    for(const auto& [k, v] : m) {
+      mrb_hash_set(mrb, hash, field_binder<key_type>::cpp_to_mrb(mrb, k),
+                              field_binder<mapped_type>::cpp_to_mrb(mrb, v));
+      mrb_gc_arena_restore(mrb, ai);
+    }
+    return hash;
+  }
+
+  static bool try_convert(mrb_state* mrb, mrb_value val, std::optional<Map>& out) {
+    if(!mrb_hash_p(val)) return false;
+    mrb_value keys = mrb_hash_keys(mrb, val);
+    Map m;
+    for(mrb_int i = 0; i < RARRAY_LEN(keys); i++) {
+      mrb_value k = RARRAY_PTR(keys)[i];
+      key_type key{};
+      mapped_type value{};
+      if(!field_from_mrb(mrb, k, key)
+      || !field_from_mrb(mrb, mrb_hash_get(mrb, val, k), value)) return false;
+      m.emplace(std::move(key), std::move(value));
+    }
+    out.emplace(std::move(m));
+    return true;
+  }
+
+  static Map mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return field_to_cpp<Map>(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return field_check_type<Map>(mrb, val);
+  }
+
+};
+
+template<typename K, typename V, typename C, typename A>
+struct field_binder<std::map<K, V, C, A>> : map_field_binder<std::map<K, V, C, A>> {};
+
+template<typename K, typename V, typename H, typename E, typename A>
+struct field_binder<std::unordered_map<K, V, H, E, A>> : map_field_binder<std::unordered_map<K, V, H, E, A>> {};
+
+/// Records are converted in one pass over their fields, using the field
+/// symbols interned in the interpreter's record table. Instances of the
+/// Struct class defined by def_record are built directly as arrays,
+/// which is how the mruby-struct gem stores them.
+template<typename Record>
+struct type_binder<Record, std::enable_if_t<is_record<std::decay_t<Record>>::value>> {
+
+  using record_type = std::decay_t<Record>;
+
+  static constexpr size_t num_fields = record_size<record_type>;
+
+  static_assert(num_fields > 0, "A record must have at least one field");
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const record_type& rec) {
+    const auto& table = get_record_table<record_type>(mrb);
+    mrb_value values[num_fields];
+    // converted fields are protected by the arena until the result holds them
+    int ai = mrb_gc_arena_save(mrb);
+    size_t i = 0;
+    std::apply([&](const auto&... f) {
+      ((values[i++] = field_binder<std::decay_t<decltype(rec.*(f.member))>>::cpp_to_mrb(mrb, rec.*(f.member))), ...);
+    }, record_traits<record_type>::fields);
+    mrb_value result;
+    if(table.struct_class) {
+      result = mrb_ary_new_from_values(mrb, num_fields, values);
+      mrb_basic_ptr(result)->c = table.struct_class;
+    } else {
+      result = mrb_hash_new_capa(mrb, num_fields);
+      for(size_t j = 0; j < num_fields; j++)
+        mrb_hash_set(mrb, result, mrb_symbol_value(table.fields[j]), values[j]);
+    }
+    mrb_gc_arena_restore(mrb, ai);
+    mrb_gc_protect(mrb, result);
+    return result;
+  }
+
+  static bool try_convert(mrb_state* mrb, mrb_value val, std::optional<record_type>& out) {
+    const auto& table = get_record_table<record_type>(mrb);
+    const mrb_value* values = nullptr;
+    if(table.struct_class && mrb_array_p(val)
+    && mrb_obj_is_kind_of(mrb, val, table.struct_class)
+    && RARRAY_LEN(val) == static_cast<mrb_int>(num_fields)) {
+      values = RARRAY_PTR(val);
+    } else if(!mrb_hash_p(val)) {
+      return false;
+    }
+    record_type rec{};
+    size_t i = 0;
+    bool converted = std::apply([&](const auto&... f) {
+      return ([&](const auto& fld) {
+        size_t j = i++;
+        mrb_value v = values ? values[j]
+                    : mrb_hash_fetch(mrb, val, mrb_symbol_value(table.fields[j]), mrb_undef_value());
+        if(mrb_undef_p(v)) return true;
+        return field_from_mrb(mrb, v, rec.*(fld.member));
+      }(f) && ...);
+    }, record_traits<record_type>::fields);
+    if(!converted) return false;
+    out.emplace(std::move(rec));
+    return true;
+  }
+
+  static record_type mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    return field_to_cpp<record_type>(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return field_check_type<record_type>(mrb, val);
+  }
+
+};
+
+/// Defines a Struct class with the fields of the record type T and
+/// makes it the Ruby representation of T. Requires the mruby-struct gem.
+template<typename T>
+struct RClass* define_record_struct(mrb_state* mrb, struct RClass* mod, const char* name) {
+  auto& table = get_record_table<T>(mrb);
+  if(!mrb_class_defined(mrb, "Struct"))
+    throw std::runtime_error("def_record requires the mruby-struct gem");
+  int ai = mrb_gc_arena_save(mrb);
+  std::vector<mrb_value> syms;
+  for(mrb_sym sym : table.fields) syms.push_back(mrb_symbol_value(sym));
+  mrb_value cls = mrb_funcall_argv(mrb, mrb_obj_value(mrb_class_get(mrb, "Struct")),
+                                   mrb_intern_lit(mrb, "new"),
+                                   static_cast<mrb_int>(syms.size()), syms.data());
+  if(mrb->exc) {
+    mrb->exc = nullptr;
+    mrb_gc_arena_restore(mrb, ai);
+    throw std::runtime_error(std::string("Could not define record ") + name);
+  }
+  struct RClass* c = mrb_class_ptr(cls);
+  if(MRB_INSTANCE_TT(c) != MRB_TT_ARRAY) {
+    mrb_gc_arena_restore(mrb, ai);
+    throw std::runtime_error("Unsupported Struct implementation");
+  }
+  mrb_define_const(mrb, mod, name, cls);
+  // the class remains valid even if a script removes the constant
+  mrb_gc_register(mrb, cls);
+  mrb_gc_arena_restore(mrb, ai);
+  table.struct_class = c;
+  return c;
+}
+
+} // namespace detail
+
+}
+
+#endif
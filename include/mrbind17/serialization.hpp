@@ -0,0 +1,370 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_SERIALIZATION_H_
+#define MRBIND17_SERIALIZATION_H_
+
+#include <mrbind17/object.hpp>
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/hash.h>
+#include <mruby/string.h>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace mrbind17 {
+
+/**
+ * Compact binary format for mruby values. Each value starts with a
+ * one-byte tag, followed by:
+ * - nothing for nil, false and true;
+ * - a zigzag-encoded varint for integers;
+ * - 8 little-endian bytes (IEEE 754) for floats;
+ * - a varint length and the raw bytes for strings and symbols;
+ * - a varint count and the elements for arrays;
+ * - a varint count and the key/value pairs for hashes.
+ */
+enum class value_tag : uint8_t {
+  nil     = 0,
+  false_  = 1,
+  true_   = 2,
+  integer = 3,
+  floating= 4,
+  string  = 5,
+  symbol  = 6,
+  array   = 7,
+  hash    = 8
+};
+
+/**
+ * @brief The binary_writer appends values to a caller-provided buffer.
+ * Values can be written either from an mrb_value, or piece by piece
+ * from C++ (begin_array/begin_hash followed by the elements), which
+ * allows producing the format without an intermediate Ruby object.
+ */
+class binary_writer {
+
+  public:
+
+  /**
+   * @brief Constructor.
+   *
+   * @param buffer Buffer to append to.
+   * @param max_depth Maximum nesting depth of arrays and hashes.
+   */
+  explicit binary_writer(std::string& buffer, unsigned max_depth = 256)
+  : m_buffer(buffer)
+  , m_max_depth(max_depth) {}
+
+  void write_nil() {
+    put_tag(value_tag::nil);
+  }
+
+  void write_bool(bool b) {
+    put_tag(b ? value_tag::true_ : value_tag::false_);
+  }
+
+  void write_int(int64_t i) {
+    put_tag(value_tag::integer);
+    put_varint((static_cast<uint64_t>(i) << 1) ^ static_cast<uint64_t>(i >> 63));
+  }
+
+  void write_float(double f) {
+    put_tag(value_tag::floating);
+    uint64_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    char bytes[8];
+    for(int i = 0; i < 8; i++) bytes[i] = static_cast<char>(bits >> (8*i));
+    m_buffer.append(bytes, 8);
+  }
+
+  void write_string(std::string_view str) {
+    put_tag(value_tag::string);
+    put_varint(str.size());
+    m_buffer.append(str.data(), str.size());
+  }
+
+  void write_symbol(std::string_view name) {
+    put_tag(value_tag::symbol);
+    put_varint(name.size());
+    m_buffer.append(name.data(), name.size());
+  }
+
+  /**
+   * @brief Starts an array of the given size. The next size values
+   * written form its elements.
+   */
+  void begin_array(size_t size) {
+    put_tag(value_tag::array);
+    put_varint(size);
+  }
+
+  /**
+   * @brief Starts a hash of the given size. The next 2*size values
+   * written form its keys and values, alternating.
+   */
+  void begin_hash(size_t size) {
+    put_tag(value_tag::hash);
+    put_varint(size);
+  }
+
+  /**
+   * @brief Writes an mrb_value. Throws std::runtime_error if the value
+   * (or one of its elements) has an unsupported type, or if it is
+   * nested deeper than the writer's maximum depth.
+   */
+  void write(mrb_state* mrb, mrb_value val) {
+    write(mrb, val, 0);
+  }
+
+  void write(const object& obj) {
+    write(obj.mrb(), obj.value(), 0);
+  }
+
+  private:
+
+  void put_tag(value_tag tag) {
+    m_buffer.push_back(static_cast<char>(tag));
+  }
+
+  void put_varint(uint64_t v) {
+    char bytes[10];
+    int n = 0;
+    while(v >= 0x80) {
+      bytes[n++] = static_cast<char>((v & 0x7f) | 0x80);
+      v >>= 7;
+    }
+    bytes[n++] = static_cast<char>(v);
+    m_buffer.append(bytes, n);
+  }
+
+  void write(mrb_state* mrb, mrb_value val, unsigned depth) {
+    switch(mrb_type(val)) {
+    case MRB_TT_FALSE:
+      if(mrb_nil_p(val)) write_nil();
+      else write_bool(false);
+      break;
+    case MRB_TT_TRUE:
+      write_bool(true);
+      break;
+    case MRB_TT_FIXNUM:
+      write_int(mrb_fixnum(val));
+      break;
+    case MRB_TT_FLOAT:
+      write_float(mrb_float(val));
+      break;
+    case MRB_TT_STRING:
+      write_string(std::string_view(RSTRING_PTR(val), RSTRING_LEN(val)));
+      break;
+    case MRB_TT_SYMBOL: {
+      mrb_int len = 0;
+      const char* name = mrb_sym2name_len(mrb, mrb_symbol(val), &len);
+      write_symbol(std::string_view(name, len));
+      break;
+    }
+    case MRB_TT_ARRAY: {
+      check_depth(depth);
+      mrb_int len = RARRAY_LEN(val);
+      begin_array(len);
+      for(mrb_int i = 0; i < len; i++)
+        write(mrb, RARRAY_PTR(val)[i], depth+1);
+      break;
+    }
+    case MRB_TT_HASH: {
+      check_depth(depth);
+      int ai = mrb_gc_arena_save(mrb);
+      mrb_value keys = mrb_hash_keys(mrb, val);
+      mrb_int len = RARRAY_LEN(keys);
+      begin_hash(len);
+      for(mrb_int i = 0; i < len; i++) {
+        mrb_value key = RARRAY_PTR(keys)[i];
+        write(mrb, key, depth+1);
+        write(mrb, mrb_hash_get(mrb, val, key), depth+1);
+      }
+      mrb_gc_arena_restore(mrb, ai);
+      break;
+    }
+    default:
+      throw std::runtime_error(std::string("Cannot serialize value of class ")
+                             + mrb_obj_classname(mrb, val));
+    }
+  }
+
+  void check_depth(unsigned depth) const {
+    if(depth >= m_max_depth)
+      throw std::runtime_error("Maximum serialization depth exceeded");
+  }
+
+  std::string& m_buffer;
+  unsigned     m_max_depth;
+};
+
+/**
+ * @brief The binary_reader builds mruby values directly in a target
+ * state from a buffer produced by a binary_writer. The buffer is read
+ * in place and is not copied; it only needs to outlive the reader.
+ */
+class binary_reader {
+
+  public:
+
+  /**
+   * @brief Constructor.
+   *
+   * @param data Pointer to the serialized data.
+   * @param size Size of the serialized data.
+   * @param max_depth Maximum nesting depth of arrays and hashes.
+   */
+  binary_reader(const char* data, size_t size, unsigned max_depth = 256)
+  : m_pos(data)
+  , m_end(data + size)
+  , m_max_depth(max_depth) {}
+
+  explicit binary_reader(std::string_view data, unsigned max_depth = 256)
+  : binary_reader(data.data(), data.size(), max_depth) {}
+
+  /**
+   * @brief Returns true if the whole buffer has been consumed.
+   */
+  bool at_end() const {
+    return m_pos == m_end;
+  }
+
+  /**
+   * @brief Reads the next value into the given state. Throws
+   * std::runtime_error if the data is truncated or malformed.
+   */
+  mrb_value read(mrb_state* mrb) {
+    int ai = mrb_gc_arena_save(mrb);
+    mrb_value val = read(mrb, 0);
+    mrb_gc_arena_restore(mrb, ai);
+    mrb_gc_protect(mrb, val);
+    return val;
+  }
+
+  private:
+
+  [[noreturn]] static void malformed() {
+    throw std::runtime_error("Malformed or truncated serialized value");
+  }
+
+  uint64_t get_varint() {
+    uint64_t v = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+      if(m_pos == m_end) malformed();
+      uint8_t byte = static_cast<uint8_t>(*m_pos++);
+      v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if(!(byte & 0x80)) return v;
+    }
+    malformed();
+  }
+
+  std::string_view get_bytes() {
+    uint64_t len = get_varint();
+    if(len > static_cast<uint64_t>(m_end - m_pos)) malformed();
+    std::string_view bytes(m_pos, len);
+    m_pos += len;
+    return bytes;
+  }
+
+  size_t get_count() {
+    uint64_t count = get_varint();
+    // every element takes at least one byte, which bounds the
+    // preallocation of a corrupted size
+    if(count > static_cast<uint64_t>(m_end - m_pos)) malformed();
+    return count;
+  }
+
+  mrb_value read(mrb_state* mrb, unsigned depth) {
+    if(m_pos == m_end) malformed();
+    switch(static_cast<value_tag>(*m_pos++)) {
+    case value_tag::nil:
+      return mrb_nil_value();
+    case value_tag::false_:
+      return mrb_false_value();
+    case value_tag::true_:
+      return mrb_true_value();
+    case value_tag::integer: {
+      uint64_t v = get_varint();
+      return mrb_fixnum_value(static_cast<mrb_int>(
+          static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1))));
+    }
+    case value_tag::floating: {
+      if(m_end - m_pos < 8) malformed();
+      uint64_t bits = 0;
+      for(int i = 0; i < 8; i++)
+        bits |= static_cast<uint64_t>(static_cast<uint8_t>(m_pos[i])) << (8*i);
+      m_pos += 8;
+      double f;
+      std::memcpy(&f, &bits, sizeof(f));
+      return mrb_float_value(mrb, f);
+    }
+    case value_tag::string: {
+      auto bytes = get_bytes();
+      return mrb_str_new(mrb, bytes.data(), bytes.size());
+    }
+    case value_tag::symbol: {
+      auto bytes = get_bytes();
+      return mrb_symbol_value(mrb_intern(mrb, bytes.data(), bytes.size()));
+    }
+    case value_tag::array: {
+      if(depth >= m_max_depth) malformed();
+      size_t count = get_count();
+      mrb_value array = mrb_ary_new_capa(mrb, count);
+      int ai = mrb_gc_arena_save(mrb);
+      for(size_t i = 0; i < count; i++) {
+        mrb_ary_push(mrb, array, read(mrb, depth+1));
+        mrb_gc_arena_restore(mrb, ai);
+      }
+      return array;
+    }
+    case value_tag::hash: {
+      if(depth >= m_max_depth) malformed();
+      size_t count = get_count();
+      mrb_value hash = mrb_hash_new_capa(mrb, count);
+      int ai = mrb_gc_arena_save(mrb);
+      for(size_t i = 0; i < count; i++) {
+        mrb_value key = read(mrb, depth+1);
+        mrb_value val = read(mrb, depth+1);
+        mrb_hash_set(mrb, hash, key, val);
+        mrb_gc_arena_restore(mrb, ai);
+      }
+      return hash;
+    }
+    default:
+      malformed();
+    }
+  }
+
+  const char* m_pos;
+  const char* m_end;
+  unsigned    m_max_depth;
+};
+
+/**
+ * @brief Serializes an object into a new string.
+ */
+inline std::string serialize(const object& obj) {
+  std::string buffer;
+  binary_writer writer(buffer);
+  writer.write(obj);
+  return buffer;
+}
+
+/**
+ * @brief Deserializes a single value into the state of the given module
+ * (e.g. another interpreter).
+ */
+inline object deserialize(const module& mod, std::string_view data) {
+  binary_reader reader(data);
+  return object(mod.mrb(), reader.read(mod.mrb()));
+}
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_SNAPSHOT_H_
+#define MRBIND17_SNAPSHOT_H_
+
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/gc.h>
+#include <mruby/proc.h>
+#include <mruby/variable.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace mrbind17 {
+
+namespace detail {
+
+/// Snapshot of the definitions of an MRuby state: global variables,
+/// method tables and variable tables (constants, class variables and
+/// class-level instance variables) of all the classes and modules, and
+/// instance variables of the top-level object. Restoring the snapshot
+/// removes the definitions added since it was taken and puts back the
+/// ones that were changed or removed. Objects created since then are no
+/// longer referenced by these tables and are reclaimed by the next
+/// collection.
+///
+/// Restoring is shallow: objects that were reachable when the snapshot
+/// was taken and were modified in place (e.g. an array stored in a
+/// constant) are not restored. Singleton classes created since the
+/// snapshot for objects that existed before are not removed.
+class snapshot {
+
+  public:
+
+  explicit snapshot(mrb_state* mrb) {
+    int ai = mrb_gc_arena_save(mrb);
+    m_roots = mrb_ary_new(mrb);
+    mrb_gc_register(mrb, m_roots);
+    std::vector<struct RClass*> classes;
+    mrb_objspace_each_objects(mrb, &collect_class, &classes);
+    m_classes.reserve(classes.size());
+    for(auto cls : classes) {
+      mrb_value val = mrb_obj_value(cls);
+      mrb_ary_push(mrb, m_roots, val);
+      m_classes.push_back({ cls, get_variables(mrb, val), get_methods(mrb, cls) });
+      for(const auto& [name, m] : m_classes.back().methods)
+        if(!MRB_METHOD_FUNC_P(m) && MRB_METHOD_PROC(m))
+          mrb_ary_push(mrb, m_roots, mrb_obj_value(MRB_METHOD_PROC(m)));
+      for(const auto& [name, value] : m_classes.back().variables)
+        mrb_ary_push(mrb, m_roots, value);
+    }
+    m_globals = get_globals(mrb);
+    for(const auto& [name, value] : m_globals)
+      mrb_ary_push(mrb, m_roots, value);
+    m_top_variables = get_variables(mrb, mrb_top_self(mrb));
+    for(const auto& [name, value] : m_top_variables)
+      mrb_ary_push(mrb, m_roots, value);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+
+  snapshot(const snapshot&) = delete;
+  snapshot& operator=(const snapshot&) = delete;
+
+  /// Stops protecting the objects referenced by the snapshot from the
+  /// garbage collector. Must be called if the snapshot is discarded
+  /// before the MRuby state is closed.
+  void release(mrb_state* mrb) {
+    mrb_gc_unregister(mrb, m_roots);
+  }
+
+  void restore(mrb_state* mrb) {
+    int ai = mrb_gc_arena_save(mrb);
+    for(const auto& saved : m_classes) {
+      mrb_value cls = mrb_obj_value(saved.cls);
+      restore_entries(saved.methods, get_methods(mrb, saved.cls), &same_method,
+        [mrb, &saved](mrb_sym name, mrb_method_t m) {
+          mrb_define_method_raw(mrb, saved.cls, name, m);
+        },
+        [mrb, cls](mrb_sym name) {
+          mrb_funcall(mrb, cls, "remove_method", 1, mrb_symbol_value(name));
+        });
+      restore_variables(mrb, cls, saved.variables);
+    }
+    restore_entries(m_globals, get_globals(mrb), same_value{ mrb },
+      [mrb](mrb_sym name, mrb_value value) { mrb_gv_set(mrb, name, value); },
+      [mrb](mrb_sym name) { mrb_gv_remove(mrb, name); });
+    restore_variables(mrb, mrb_top_self(mrb), m_top_variables);
+    mrb_gc_arena_restore(mrb, ai);
+  }
+
+  private:
+
+  template<typename T>
+  using entries = std::vector<std::pair<mrb_sym, T>>;
+
+  struct class_state {
+    struct RClass*         cls;
+    entries<mrb_value>     variables;
+    entries<mrb_method_t>  methods;
+  };
+
+  static int collect_class(mrb_state* mrb, struct RBasic* obj, void* data) {
+    switch(obj->tt) {
+      case MRB_TT_CLASS:
+      case MRB_TT_MODULE:
+      case MRB_TT_SCLASS:
+        static_cast<std::vector<struct RClass*>*>(data)->push_back(reinterpret_cast<struct RClass*>(obj));
+        break;
+      default:
+        break;
+    }
+    return MRB_EACH_OBJ_OK;
+  }
+
+  template<typename T>
+  static void sort(entries<T>& e) {
+    std::sort(e.begin(), e.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+  }
+
+  static entries<mrb_value> get_variables(mrb_state* mrb, mrb_value obj) {
+    entries<mrb_value> result;
+    mrb_iv_foreach(mrb, obj, [](mrb_state*, mrb_sym name, mrb_value value, void* data) {
+      static_cast<entries<mrb_value>*>(data)->emplace_back(name, value);
+      return 0;
+    }, &result);
+    sort(result);
+    return result;
+  }
+
+  static entries<mrb_method_t> get_methods(mrb_state* mrb, struct RClass* cls) {
+    entries<mrb_method_t> result;
+    mrb_mt_foreach(mrb, cls, [](mrb_state*, mrb_sym name, mrb_method_t m, void* data) {
+      static_cast<entries<mrb_method_t>*>(data)->emplace_back(name, m);
+      return 0;
+    }, &result);
+    sort(result);
+    return result;
+  }
+
+  static entries<mrb_value> get_globals(mrb_state* mrb) {
+    entries<mrb_value> result;
+    mrb_value names = mrb_f_global_variables(mrb, mrb_top_self(mrb));
+    for(mrb_int i = 0; i < RARRAY_LEN(names); i++) {
+      mrb_sym name = mrb_symbol(RARRAY_PTR(names)[i]);
+      result.emplace_back(name, mrb_gv_get(mrb, name));
+    }
+    sort(result);
+    return result;
+  }
+
+  struct same_value {
+    mrb_state* mrb;
+    bool operator()(mrb_value a, mrb_value b) const {
+      return mrb_obj_eq(mrb, a, b);
+    }
+  };
+
+  static bool same_method(mrb_method_t a, mrb_method_t b) {
+    if(MRB_METHOD_FUNC_P(a) != MRB_METHOD_FUNC_P(b)) return false;
+    if(MRB_METHOD_FUNC_P(a)) return MRB_METHOD_FUNC(a) == MRB_METHOD_FUNC(b);
+    return MRB_METHOD_PROC(a) == MRB_METHOD_PROC(b);
+  }
+
+  static void restore_variables(mrb_state* mrb, mrb_value obj, const entries<mrb_value>& saved) {
+    restore_entries(saved, get_variables(mrb, obj), same_value{ mrb },
+      [mrb, obj](mrb_sym name, mrb_value value) { mrb_iv_set(mrb, obj, name, value); },
+      [mrb, obj](mrb_sym name) { mrb_iv_remove(mrb, obj, name); });
+  }
+
+  /// Walks the saved and current entries, both sorted by name, setting
+  /// the entries that were changed or removed and removing the new ones.
+  template<typename T, typename Same, typename Set, typename Remove>
+  static void restore_entries(const entries<T>& saved, const entries<T>& current,
+                              Same same, Set set, Remove remove) {
+    auto s = saved.begin();
+    auto c = current.begin();
+    while(s != saved.end() || c != current.end()) {
+      if(c == current.end() || (s != saved.end() && s->first < c->first)) {
+        set(s->first, s->second);
+        ++s;
+      } else if(s == saved.end() || c->first < s->first) {
+        remove(c->first);
+        ++c;
+      } else {
+        if(!same(s->second, c->second)) set(s->first, s->second);
+        ++s;
+        ++c;
+      }
+    }
+  }
+
+  mrb_value                m_roots;
+  std::vector<class_state> m_classes;
+  entries<mrb_value>       m_globals;
+  entries<mrb_value>       m_top_variables;
+};
+
+} // namespace detail
+
+}
+
+#endif
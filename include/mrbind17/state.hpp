@@ -0,0 +1,147 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_STATE_H_
+#define MRBIND17_STATE_H_
+
+#include <mrbind17/enum_table.hpp>
+#include <mruby.h>
+#include <mruby/data.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mrbind17 {
+
+namespace detail {
+
+class memo_cache;
+
+/// Interface of the objects sampling the call stack of an interpreter.
+/// The sampler's timer increments pending; the interpreter takes the
+/// pending samples at the next safe point.
+class sampler {
+
+  public:
+
+  virtual ~sampler() = default;
+
+  /// Records the pending samples. pc is the instruction about to be
+  /// executed by the innermost Ruby frame, or nullptr if the innermost
+  /// frame is a C function.
+  virtual void take_samples(mrb_state* mrb, const mrb_code* pc) = 0;
+
+  std::atomic<unsigned> pending = { 0 };
+};
+
+/// Key of the identity map: address of a C++ instance and the
+/// mrb_data_type of the objects wrapping instances of its bound type.
+struct wrapper_key {
+  const void*          ptr;
+  const mrb_data_type* type;
+
+  bool operator==(const wrapper_key& other) const {
+    return ptr == other.ptr && type == other.type;
+  }
+};
+
+struct wrapper_key_hash {
+  size_t operator()(const wrapper_key& key) const {
+    return std::hash<const void*>()(key.ptr) ^ (std::hash<const void*>()(key.type) << 1);
+  }
+};
+
+/// Live Ruby object wrapping a C++ instance it does not own, along with
+/// the instance structure it holds. Entries are weak: the GC removes
+/// them when freeing the object.
+struct wrapper_entry {
+  RData*      data;
+  const void* inst;
+};
+
+using wrapper_map = std::unordered_map<wrapper_key, wrapper_entry, wrapper_key_hash>;
+
+/// Symbols of the fields of a C++ record type, interned once per
+/// interpreter, and the Struct class bound to it by module::def_record
+/// (nullptr if records of this type are represented by hashes).
+struct record_table {
+  std::vector<mrb_sym> fields;
+  struct RClass*       struct_class = nullptr;
+};
+
+inline size_t next_record_type_index() {
+  static std::atomic<size_t> next = { 0 };
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+size_t record_type_index() {
+  static const size_t index = next_record_type_index();
+  return index;
+}
+
+/// Script library registered with interpreter::autoload, executed the
+/// first time a script references the constant it defines.
+struct autoload_entry {
+  enum class kind { script, file, bytecode };
+
+  kind           type;
+  std::string    source;         /* script text or file path */
+  const uint8_t* data   = nullptr; /* bytecode, not owned */
+  size_t         size   = 0;
+  bool           loaded = false;
+};
+
+/// C++ state attached to each MRuby state created by an interpreter,
+/// reachable from the mrb_state through its ud field.
+struct state {
+  sampler*                                          active_sampler = nullptr;
+  std::unordered_multimap<std::string, memo_cache*> memo_caches;
+  std::vector<std::unique_ptr<enum_table>>          enum_tables; /* by enum_type_index */
+  std::vector<std::unique_ptr<record_table>>        record_tables; /* by record_type_index */
+  struct RClass*                                    iterable_class       = nullptr;
+  struct RClass*                                    future_class         = nullptr;
+  wrapper_map                                       wrappers; /* identity map of unowned instances */
+  std::unordered_map<std::string, autoload_entry>   autoloads; /* by constant path */
+  std::vector<std::string>                          autoloaded; /* in load order */
+  size_t                                            autoloaded_at_checkpoint = 0;
+  size_t                                            allocated_bytes      = 0;
+  size_t                                            peak_allocated_bytes = 0;
+};
+
+/// Returns the C++ state of an MRuby state created by an interpreter.
+inline state* get_state(mrb_state* mrb) {
+  return static_cast<state*>(mrb->ud);
+}
+
+/// Returns the table of the enum E registered with module::def_enum,
+/// or nullptr if E was not bound in this MRuby state.
+template<typename E>
+const enum_table* get_enum_table(mrb_state* mrb) {
+  auto s = get_state(mrb);
+  size_t index = enum_type_index<E>();
+  if(!s || index >= s->enum_tables.size()) return nullptr;
+  return s->enum_tables[index].get();
+}
+
+/// Safe point at which pending stack samples are taken, e.g. when a
+/// bound C++ function returns, so that the time spent in the function
+/// is attributed to it.
+inline void sample_point(mrb_state* mrb, const mrb_code* pc = nullptr) {
+  auto s = get_state(mrb);
+  if(s && s->active_sampler
+  && s->active_sampler->pending.load(std::memory_order_relaxed) != 0)
+    s->active_sampler->take_samples(mrb, pc);
+}
+
+} // namespace detail
+
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_SYMBOL_H_
+#define MRBIND17_SYMBOL_H_
+
+#include <mruby.h>
+#include <string>
+#include <string_view>
+
+namespace mrbind17 {
+
+/**
+ * @brief Name known to be a string literal, created with the _name
+ * suffix from mrbind17::literals (e.g. "each"_name). Its length is
+ * known at compile time and its storage is static.
+ */
+struct static_name {
+  const char* data;
+  size_t      size;
+};
+
+namespace literals {
+
+constexpr static_name operator""_name(const char* str, size_t len) {
+  return { str, len };
+}
+
+}
+
+/**
+ * @brief The symbol class holds a name interned once in a given
+ * MRuby state, so that it can be used repeatedly without hashing
+ * or copying the name again.
+ *
+ * When constructed from a static_name, the literal itself is used as
+ * the symbol's storage (mrb_intern_static), so no copy is made either.
+ * Other names, including character arrays, are copied.
+ */
+class symbol {
+
+  public:
+
+  /**
+   * @brief Interns a string literal without copying it.
+   */
+  symbol(mrb_state* mrb, static_name name)
+  : m_mrb(mrb)
+  , m_sym(mrb_intern_static(mrb, name.data, name.size)) {}
+
+  /**
+   * @brief Interns a name whose storage is not static. A character
+   * array is interned up to its first null character.
+   */
+  symbol(mrb_state* mrb, std::string_view name)
+  : m_mrb(mrb)
+  , m_sym(mrb_intern(mrb, name.data(), name.size())) {}
+
+  /**
+   * @brief Wraps an already interned symbol.
+   */
+  symbol(mrb_state* mrb, mrb_sym sym)
+  : m_mrb(mrb)
+  , m_sym(sym) {}
+
+  symbol(const symbol&) = default;
+
+  symbol& operator=(const symbol&) = default;
+
+  mrb_state* mrb() const { return m_mrb; }
+
+  mrb_sym id() const { return m_sym; }
+
+  std::string name() const {
+    mrb_int len = 0;
+    const char* str = mrb_sym2name_len(m_mrb, m_sym, &len);
+    return std::string(str, len);
+  }
+
+  bool operator==(const symbol& other) const {
+    return m_mrb == other.m_mrb && m_sym == other.m_sym;
+  }
+
+  bool operator!=(const symbol& other) const {
+    return !(*this == other);
+  }
+
+  private:
+
+  mrb_state* m_mrb;
+  mrb_sym    m_sym;
+};
+
+}
+
+#endif
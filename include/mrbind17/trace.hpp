@@ -0,0 +1,307 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_TRACE_H_
+#define MRBIND17_TRACE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace mrbind17 {
+
+/**
+ * @brief Categories of trace events.
+ */
+enum class trace_category : uint8_t {
+  execute, /*!< interpreter::execute */
+  compile, /*!< Compilation of a script */
+  call,    /*!< Call to a bound C++ function */
+  gc       /*!< Garbage collection requested by the host */
+};
+
+/**
+ * @brief A trace event, marking the beginning ('B') or the end ('E')
+ * of an operation. Names longer than the buffer are truncated.
+ */
+struct trace_event {
+  uint64_t       timestamp; /*!< Nanoseconds, from std::chrono::steady_clock */
+  uint32_t       thread_id; /*!< Identifier of the recording thread */
+  char           phase;     /*!< 'B' or 'E' */
+  trace_category category;
+  char           name[46];  /*!< Null-terminated name */
+};
+
+using trace_callback = std::function<void(const trace_event&)>;
+
+inline const char* trace_category_name(trace_category category) {
+  switch(category) {
+    case trace_category::execute: return "execute";
+    case trace_category::compile: return "compile";
+    case trace_category::call:    return "call";
+    case trace_category::gc:      return "gc";
+  }
+  return "";
+}
+
+namespace detail {
+
+/// Ring buffer of trace events written by a single thread. Writing does
+/// not take any lock; when the buffer is full the oldest events are
+/// overwritten. Readers copy the events and discard the ones that may
+/// have been overwritten while copying. The ring has one slot more than
+/// the capacity: the writer may be overwriting the slot following the
+/// last capacity events, which readers never return.
+class trace_buffer {
+
+  public:
+
+  trace_buffer(size_t capacity, uint32_t thread_id)
+  : m_events(std::max<size_t>(capacity, 1) + 1)
+  , m_thread_id(thread_id) {}
+
+  uint32_t thread_id() const {
+    return m_thread_id;
+  }
+
+  void push(const trace_event& event) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    m_events[head % m_events.size()] = event;
+    m_head.store(head + 1, std::memory_order_release);
+  }
+
+  void snapshot(std::vector<trace_event>& out) const {
+    const uint64_t slots    = m_events.size();
+    const uint64_t capacity = slots - 1;
+    uint64_t head  = m_head.load(std::memory_order_acquire);
+    uint64_t begin = std::max(m_cleared.load(std::memory_order_relaxed),
+                              head > capacity ? head - capacity : 0);
+    size_t start = out.size();
+    for(uint64_t i = begin; i < head; i++)
+      out.push_back(m_events[i % slots]);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // a writer that claimed index new_head is overwriting event
+    // new_head - slots, so only events from new_head - capacity
+    // on are known to be intact
+    uint64_t new_head = m_head.load(std::memory_order_relaxed);
+    uint64_t valid    = new_head > capacity ? new_head - capacity : 0;
+    if(valid > begin) {
+      auto overwritten = std::min(valid, head) - begin;
+      out.erase(out.begin() + start, out.begin() + start + overwritten);
+    }
+  }
+
+  void clear() {
+    m_cleared.store(m_head.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+
+  private:
+
+  std::vector<trace_event> m_events;
+  std::atomic<uint64_t>    m_head    = { 0 };
+  std::atomic<uint64_t>    m_cleared = { 0 };
+  uint32_t                 m_thread_id;
+};
+
+/// Process-wide tracing configuration and the buffers of all the
+/// threads that recorded events.
+struct trace_registry {
+  std::atomic<bool>                          enabled      = { false };
+  std::atomic<bool>                          has_callback = { false };
+  std::shared_ptr<const trace_callback>      callback;
+  std::mutex                                 mutex;
+  std::vector<std::shared_ptr<trace_buffer>> buffers;
+  size_t                                     capacity       = 16384;
+  uint32_t                                   next_thread_id = 1;
+};
+
+inline trace_registry& get_trace_registry() {
+  static trace_registry registry;
+  return registry;
+}
+
+inline trace_buffer& local_trace_buffer() {
+  static thread_local std::shared_ptr<trace_buffer> buffer = []() {
+    auto& registry = get_trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto b = std::make_shared<trace_buffer>(registry.capacity, registry.next_thread_id++);
+    registry.buffers.push_back(b);
+    return b;
+  }();
+  return *buffer;
+}
+
+inline bool tracing_enabled() {
+  return get_trace_registry().enabled.load(std::memory_order_relaxed);
+}
+
+inline void record_trace_event(char phase, trace_category category, std::string_view name) {
+  auto& buffer = local_trace_buffer();
+  trace_event event;
+  event.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  event.thread_id = buffer.thread_id();
+  event.phase     = phase;
+  event.category  = category;
+  auto len = std::min(name.size(), sizeof(event.name) - 1);
+  std::memcpy(event.name, name.data(), len);
+  event.name[len] = '\0';
+  buffer.push(event);
+  auto& registry = get_trace_registry();
+  if(registry.has_callback.load(std::memory_order_relaxed)) {
+    auto callback = std::atomic_load(&registry.callback);
+    if(callback) (*callback)(event);
+  }
+}
+
+/// Records a begin event on construction and the matching end event on
+/// destruction, if tracing is enabled when the scope starts. The name
+/// must outlive the scope.
+class trace_scope {
+
+  public:
+
+  trace_scope(trace_category category, std::string_view name)
+  : m_active(tracing_enabled())
+  , m_category(category)
+  , m_name(name) {
+    if(m_active) record_trace_event('B', m_category, m_name);
+  }
+
+  explicit trace_scope(trace_category category)
+  : trace_scope(category, trace_category_name(category)) {}
+
+  trace_scope(const trace_scope&) = delete;
+  trace_scope& operator=(const trace_scope&) = delete;
+
+  ~trace_scope() {
+    if(m_active) record_trace_event('E', m_category, m_name);
+  }
+
+  private:
+
+  bool             m_active;
+  trace_category   m_category;
+  std::string_view m_name;
+};
+
+} // namespace detail
+
+/**
+ * @brief The tracing namespace controls the recording of trace events
+ * by all interpreters of the process. Events are recorded in a ring
+ * buffer per thread, without locking, and can be collected at any time
+ * or forwarded to a callback as they are recorded.
+ */
+namespace tracing {
+
+/**
+ * @brief Enables or disables the recording of trace events.
+ * When disabled, recording an event costs a relaxed atomic load.
+ */
+inline void enable(bool on = true) {
+  detail::get_trace_registry().enabled.store(on, std::memory_order_relaxed);
+}
+
+inline void disable() {
+  enable(false);
+}
+
+inline bool enabled() {
+  return detail::tracing_enabled();
+}
+
+/**
+ * @brief Sets the number of events kept per thread. Only affects the
+ * buffers of threads that have not recorded any event yet.
+ */
+inline void set_buffer_capacity(size_t capacity) {
+  auto& registry = detail::get_trace_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.capacity = capacity;
+}
+
+/**
+ * @brief Sets a callback invoked for each event, on the thread recording
+ * it, in addition to storing the event in the thread's buffer. Passing
+ * an empty function removes the callback.
+ */
+inline void set_callback(trace_callback callback) {
+  auto& registry = detail::get_trace_registry();
+  std::shared_ptr<const trace_callback> ptr;
+  if(callback) ptr = std::make_shared<const trace_callback>(std::move(callback));
+  std::atomic_store(&registry.callback, ptr);
+  registry.has_callback.store(static_cast<bool>(ptr), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the events currently held by the buffers of all
+ * threads, grouped by thread and in the order they were recorded.
+ */
+inline std::vector<trace_event> collect() {
+  auto& registry = detail::get_trace_registry();
+  std::vector<std::shared_ptr<detail::trace_buffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffers = registry.buffers;
+  }
+  std::vector<trace_event> events;
+  for(const auto& buffer : buffers) buffer->snapshot(events);
+  return events;
+}
+
+/**
+ * @brief Discards the events recorded so far.
+ */
+inline void clear() {
+  auto& registry = detail::get_trace_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(const auto& buffer : registry.buffers) buffer->clear();
+}
+
+/**
+ * @brief Writes the events in Chrome's trace event JSON format,
+ * which can be loaded in chrome://tracing or Perfetto.
+ */
+inline void write_chrome_json(std::ostream& os, const std::vector<trace_event>& events) {
+  os << "{\"traceEvents\":[";
+  bool first = true;
+  for(const auto& event : events) {
+    if(!first) os << ',';
+    first = false;
+    os << "{\"name\":\"";
+    for(const char* c = event.name; *c; c++) {
+      if(*c == '"' || *c == '\\') os << '\\' << *c;
+      else if(static_cast<unsigned char>(*c) < 0x20) os << ' ';
+      else os << *c;
+    }
+    os << "\",\"cat\":\"" << trace_category_name(event.category)
+       << "\",\"ph\":\"" << event.phase
+       << "\",\"ts\":" << event.timestamp / 1000 << '.'
+       << static_cast<char>('0' + (event.timestamp / 100) % 10)
+       << static_cast<char>('0' + (event.timestamp / 10) % 10)
+       << static_cast<char>('0' + event.timestamp % 10)
+       << ",\"pid\":0,\"tid\":" << event.thread_id << '}';
+  }
+  os << "],\"displayTimeUnit\":\"ns\"}";
+}
+
+inline void write_chrome_json(std::ostream& os) {
+  write_chrome_json(os, collect());
+}
+
+} // namespace tracing
+
+}
+
+#endif
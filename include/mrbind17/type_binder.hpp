@@ -4,8 +4,16 @@
 #include <mruby.h>
 #include <mruby/string.h>
 #include <mrbind17/mruby_util.hpp>
+#include <mrbind17/instance.hpp>
 #include <mrbind17/type_registry.hpp>
 #include <mrbind17/type_traits.hpp>
+#include <mrbind17/state.hpp>
+#include <array>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace mrbind17 {
 
@@ -16,14 +24,72 @@ namespace detail {
 /// - mrb_to_cpp converts an mrb_value to a C++ value
 /// - check_type checks if an mrb_value is convertible to the given C++ type
 
+/// By default, a type is expected to be a C++ class bound to Ruby with
+/// module::def_class. Values are copied into a new Ruby object that owns
+/// the copy; Ruby objects are converted back into a reference to the
+/// wrapped instance, and any other object throws std::invalid_argument.
 template<typename T, typename Enable = void>
-struct type_binder;
+struct type_binder {
+
+  using class_type = std::remove_cv_t<std::remove_reference_t<T>>;
+
+  static_assert(std::is_class<class_type>::value,
+                "No type_binder is available for this type");
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, class_type val) {
+    return wrap_instance<class_type>(mrb, new class_type(std::move(val)), true);
+  }
+
+  static class_type& mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    class_type* instance = get_instance<class_type>(mrb, val);
+    if(!instance) {
+      throw std::invalid_argument(std::string("Cannot convert ")
+          + mrb_obj_classname(mrb, val) + " into " + get_cpp_class_name<class_type>(mrb));
+    }
+    return *instance;
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return get_instance<class_type>(mrb, val) != nullptr;
+  }
+
+};
+
+/// Pointers to instances of bound C++ classes are wrapped without
+/// transferring ownership; nullptr is converted into nil and vice versa.
+/// Converting the same pointer again returns the same Ruby object while
+/// that object is alive.
+template<typename Pointer>
+struct type_binder<Pointer, std::enable_if_t<is_class_pointer<Pointer>::value>> {
+
+  static constexpr bool borrowed = true;
+
+  using class_type = std::remove_cv_t<std::remove_pointer_t<std::decay_t<Pointer>>>;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, const class_type* ptr) {
+    if(!ptr) return mrb_nil_value();
+    return wrap_unowned_instance<class_type>(mrb, const_cast<class_type*>(ptr));
+  }
+
+  static class_type* mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    if(mrb_nil_p(val)) return nullptr;
+    return get_instance<class_type>(mrb, val);
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_nil_p(val) || get_instance<class_type>(mrb, val) != nullptr;
+  }
+
+};
 
 template<typename Value>
 struct type_binder<Value,
   std::enable_if_t<
     std::is_same<std::decay_t<Value>, mrb_value>::value>> {
 
+  static constexpr bool infallible = true;
+  static constexpr bool borrowed   = true;
+
   static constexpr mrb_value cpp_to_mrb(mrb_state* mrb, mrb_value val) {
     return val;
   }
@@ -53,6 +119,14 @@ struct type_binder<Integer, std::enable_if_t<is_integer_not_bool<Integer>::value
     return mrb_fixnum_p(val) || mrb_float_p(val);
   }
 
+  static bool try_convert(mrb_state* mrb, mrb_value val, std::optional<std::decay_t<Integer>>& out) {
+    switch(mrb_type(val)) {
+      case MRB_TT_FIXNUM: out.emplace(mrb_fixnum(val)); return true;
+      case MRB_TT_FLOAT:  out.emplace(mrb_float(val));  return true;
+      default:            return false;
+    }
+  }
+
 };
 
 template<typename Float>
@@ -70,11 +144,21 @@ struct type_binder<Float, std::enable_if_t<is_floating_point<Float>::value>> {
     return mrb_fixnum_p(val) || mrb_float_p(val);
   }
 
+  static bool try_convert(mrb_state* mrb, mrb_value val, std::optional<std::decay_t<Float>>& out) {
+    switch(mrb_type(val)) {
+      case MRB_TT_FIXNUM: out.emplace(mrb_fixnum(val)); return true;
+      case MRB_TT_FLOAT:  out.emplace(mrb_float(val));  return true;
+      default:            return false;
+    }
+  }
+
 };
 
 template<typename Bool>
 struct type_binder<Bool, std::enable_if_t<is_bool<Bool>::value>> {
-  
+
+  static constexpr bool infallible = true;
+
   static mrb_value cpp_to_mrb(mrb_state* mrb, Bool b) {
     return b ? mrb_true_value() : mrb_false_value();
   }
@@ -88,9 +172,48 @@ struct type_binder<Bool, std::enable_if_t<is_bool<Bool>::value>> {
   }
 };
 
+/// Enums bound with module::def_enum are represented by symbols in Ruby.
+/// Both conversions are lookups in arrays indexed by symbol id and by
+/// value; values without a name are converted into integers.
+template<typename Enum>
+struct type_binder<Enum, std::enable_if_t<std::is_enum<std::decay_t<Enum>>::value>> {
+
+  using enum_type = std::decay_t<Enum>;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, Enum e) {
+    auto value = static_cast<int64_t>(e);
+    auto table = get_enum_table<enum_type>(mrb);
+    mrb_sym sym = table ? table->to_symbol(value) : 0;
+    return sym ? mrb_symbol_value(sym) : mrb_fixnum_value(value);
+  }
+
+  static enum_type mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    std::optional<enum_type> out;
+    try_convert(mrb, val, out);
+    return out.value_or(enum_type{});
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    std::optional<enum_type> out;
+    return try_convert(mrb, val, out);
+  }
+
+  static bool try_convert(mrb_state* mrb, mrb_value val, std::optional<enum_type>& out) {
+    if(!mrb_symbol_p(val)) return false;
+    auto table = get_enum_table<enum_type>(mrb);
+    int64_t value;
+    if(!table || !table->to_value(mrb_symbol(val), value)) return false;
+    out.emplace(static_cast<enum_type>(value));
+    return true;
+  }
+
+};
+
 template<typename CString>
 struct type_binder<CString, std::enable_if_t<is_c_style_string<CString>::value>> {
-  
+
+  static constexpr bool borrowed = true;
+
   static mrb_value cpp_to_mrb(mrb_state* mrb, CString str) {
     int ai = mrb_gc_arena_save(mrb);
     auto val = mrb_str_new_cstr(mrb, str);
@@ -134,10 +257,40 @@ struct type_binder<String, std::enable_if_t<is_string<String>::value>> {
 
 };
 
+/// String views passed as arguments refer to the bytes of the Ruby
+/// String (or the name of the Symbol) without copying them; the view
+/// is only valid for the duration of the call.
+template<typename StringView>
+struct type_binder<StringView, std::enable_if_t<std::is_same<std::string_view, std::decay_t<StringView>>::value>> {
+
+  static constexpr bool borrowed = true;
+
+  static mrb_value cpp_to_mrb(mrb_state* mrb, StringView str) {
+    int ai = mrb_gc_arena_save(mrb);
+    auto val = mrb_str_new(mrb, str.data(), str.size());
+    mrb_gc_arena_restore(mrb, ai);
+    return val;
+  }
+
+  static std::string_view mrb_to_cpp(mrb_state* mrb, mrb_value val) {
+    if(mrb_symbol_p(val)) {
+      mrb_int len = 0;
+      const char* name = mrb_sym2name_len(mrb, mrb_symbol(val), &len);
+      return std::string_view(name, len);
+    }
+    return std::string_view(RSTRING_PTR(val), RSTRING_LEN(val));
+  }
+
+  static bool check_type(mrb_state* mrb, mrb_value val) {
+    return mrb_string_p(val) || mrb_symbol_p(val);
+  }
+
+};
+
 
 template<typename T>
 mrb_value cpp_to_mrb(mrb_state* mrb, T val) {
-  return type_binder<T>::cpp_to_mrb(mrb, val);
+  return type_binder<T>::cpp_to_mrb(mrb, std::move(val));
 }
 
 template<typename T>
@@ -150,58 +303,144 @@ bool check_type(mrb_state* mrb, mrb_value val) {
   return type_binder<T>::check_type(mrb, val);
 }
 
-/// Helper structure to check the types of a series of values
-template<class ... P>
-struct type_checker {};
+/// Type-erased description of a parameter type. A single instance
+/// exists per type, shared by all the bindings using that type.
+struct arg_type_info {
+  std::string (*name)(mrb_state*);
+  bool        (*check)(mrb_state*, mrb_value);
+};
 
-template<>
-struct type_checker<> {
-  static bool check(mrb_state* mrb, int i, mrb_value* args, bool should_throw) {
-    return true;
-  }
+template<typename T>
+inline constexpr arg_type_info arg_type_info_v = {
+  &get_cpp_class_name<std::decay_t<T>>,
+  &check_type<std::decay_t<T>>
 };
 
-template<class P>
-struct type_checker<P> {
-  static bool check(mrb_state* mrb, int i, mrb_value* args, bool should_throw) {
-    if(!type_binder<P>::check_type(mrb, args[i])) {
-      if(should_throw) {
-        auto type_name = get_cpp_class_name<P>(mrb);
-        raise_invalid_type(mrb, i, type_name.c_str(), args[i]);
-      }
-      return false;
-    }
-    return true;
-  }
+/// Table of the parameter types of a signature
+template<typename ... P>
+inline constexpr std::array<const arg_type_info*, sizeof...(P)> arg_type_table = {
+  &arg_type_info_v<P>...
 };
 
-template<class P1, class ... P>
-struct type_checker<P1, P...> {
-  static bool check(mrb_state* mrb, int i, mrb_value* args, bool should_throw) {
-    if(!type_binder<P1>::check_type(mrb, args[i])) {
-      if(should_throw) {
-        auto type_name = get_cpp_class_name<P1>(mrb);
-        raise_invalid_type(mrb, i, type_name.c_str(), args[i]);
-      }
-      return false;
-    } else {
-      return type_checker<P...>::check(mrb, i+1, args, should_throw);
+/// Checks that a C-style array of arguments matches a table of types
+inline bool check_arg_types(mrb_state* mrb, mrb_value* args,
+                            const arg_type_info* const* types, size_t n,
+                            bool should_throw) {
+  for(size_t i = 0; i < n; i++) {
+    if(types[i]->check(mrb, args[i])) continue;
+    if(should_throw) {
+      auto type_name = types[i]->name(mrb);
+      raise_invalid_type(mrb, i, type_name.c_str(), args[i]);
     }
+    return false;
   }
-};
+  return true;
+}
 
 /// Checks that a C-style array of arguments matches the provided types
 template<class ... P>
 bool check_arg_types(mrb_state* mrb, mrb_value* args, bool should_throw=true) {
-  return type_checker<P...>::check(mrb, 0, args, should_throw);
+  return check_arg_types(mrb, args, arg_type_table<P...>.data(), sizeof...(P), should_throw);
 }
 
-/// Helper structure for parameter pack expension in function_binder.hpp
+/// Detects type_binders providing a fused check-and-convert function
+/// try_convert(mrb, val, std::optional<T>& out), which returns false
+/// without touching out if val cannot be converted.
+template<typename Binder, typename T, typename = void>
+struct has_try_convert : std::false_type {};
+
+template<typename Binder, typename T>
+struct has_try_convert<Binder, T, std::void_t<decltype(Binder::try_convert(
+    std::declval<mrb_state*>(), std::declval<mrb_value>(),
+    std::declval<std::optional<T>&>()))>> : std::true_type {};
+
+/// Detects type_binders providing convert_ref(mrb, val, std::optional<T>& holder),
+/// which returns a pointer to an existing C++ object wrapped by val, or
+/// converts val into holder and returns a pointer to it, or returns
+/// nullptr if val cannot be converted. Arguments of such types taken by
+/// reference refer to the wrapped object instead of a copy.
+template<typename Binder, typename T, typename = void>
+struct has_convert_ref : std::false_type {};
+
+template<typename Binder, typename T>
+struct has_convert_ref<Binder, T, std::void_t<decltype(Binder::convert_ref(
+    std::declval<mrb_state*>(), std::declval<mrb_value>(),
+    std::declval<std::optional<T>&>()))>> : std::true_type {};
+
+/// Detects binders declaring static constexpr bool infallible = true,
+/// i.e. whose check_type accepts any value (e.g. mrb_value, bool) and
+/// whose mrb_to_cpp cannot fail.
+template<typename T, typename = void>
+struct is_infallible_arg : std::false_type {};
+
 template<typename T>
-struct type_converter {
-  static std::decay_t<T> convert(mrb_state* mrb, mrb_value v) {
-    return mrb_to_cpp<std::decay_t<T>>(mrb, v);
+struct is_infallible_arg<T, std::enable_if_t<type_binder<std::decay_t<T>>::infallible>> : std::true_type {};
+
+/// Checks if the binder of an argument of type T declares it borrowed,
+/// i.e. the converted value refers to Ruby objects or to memory owned
+/// by them, and is only valid on the interpreter's thread for the
+/// duration of the call.
+template<typename T, typename = void>
+struct is_borrowed_arg : std::false_type {};
+
+template<typename T>
+struct is_borrowed_arg<T, std::enable_if_t<type_binder<std::decay_t<T>>::borrowed>> : std::true_type {};
+
+/// Holds an argument of type P of a bound function while it is being
+/// converted. Binders returning references (e.g. to instances of bound
+/// classes) are held by pointer, so the instance is only copied if the
+/// parameter is taken by value.
+template<typename P>
+class arg_converter {
+
+  using binder     = type_binder<std::decay_t<P>>;
+  using converted  = decltype(binder::mrb_to_cpp(std::declval<mrb_state*>(), std::declval<mrb_value>()));
+  using value_type = std::decay_t<converted>;
+
+  static constexpr bool by_pointer = std::is_lvalue_reference<converted>::value;
+  static constexpr bool by_ref     = !by_pointer && has_convert_ref<binder, value_type>::value;
+
+  public:
+
+  /// Checks and converts the argument in one pass, returning false if
+  /// the argument does not have the expected type.
+  bool convert(mrb_state* mrb, mrb_value val) {
+    if constexpr (by_pointer) {
+      if(!binder::check_type(mrb, val)) return false;
+      m_pointer = &binder::mrb_to_cpp(mrb, val);
+      return true;
+    } else if constexpr (by_ref) {
+      m_pointer = binder::convert_ref(mrb, val, m_value);
+      return m_pointer != nullptr;
+    } else if constexpr (has_try_convert<binder, value_type>::value) {
+      return binder::try_convert(mrb, val, m_value);
+    } else {
+      if(!binder::check_type(mrb, val)) return false;
+      m_value.emplace(binder::mrb_to_cpp(mrb, val));
+      return true;
+    }
   }
+
+  /// Returns the converted argument, to be passed to the function.
+  decltype(auto) get() {
+    if constexpr (by_ref && std::is_reference<P>::value) {
+      return *m_pointer;
+    } else if constexpr (by_ref) {
+      if(m_value) return value_type(std::move(*m_value));
+      return value_type(*m_pointer);
+    } else if constexpr (!by_pointer) {
+      return std::move(*m_value);
+    } else if constexpr (std::is_reference<P>::value) {
+      return *m_pointer;
+    } else {
+      return value_type(*m_pointer);
+    }
+  }
+
+  private:
+
+  std::optional<value_type>           m_value;
+  std::remove_reference_t<converted>* m_pointer = nullptr;
 };
 
 } // namespace detail
@@ -217,8 +456,11 @@ namespace detail {
 template<typename Object>
 struct type_binder<Object, std::enable_if_t<std::is_same<std::decay_t<Object>,object>::value>> {
 
+  static constexpr bool infallible = true;
+  static constexpr bool borrowed   = true;
+
   static mrb_value cpp_to_mrb(mrb_state* mrb, Object val) {
-    return val.native();
+    return val.value();
   }
 
   static auto mrb_to_cpp(mrb_state* mrb, mrb_value val) {
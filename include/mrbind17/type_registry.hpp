@@ -2,6 +2,7 @@
 #define MRBIND17_TYPE_REGISTRY_H_
 
 #include <mruby.h>
+#include <mruby/class.h>
 #include <mruby/hash.h>
 #include <mruby/variable.h>
 #include <mruby/string.h>
@@ -93,6 +94,35 @@ std::string get_cpp_class_name(mrb_state* mrb) {
   return std::string(RSTRING_PTR(val), RSTRING_LEN(val));
 }
 
+/// This function associates the MRuby class bound to C++ type T
+/// with this type in the $__cpp_classes__ hash of the mrb_state
+template<typename T>
+void register_cpp_class(mrb_state* mrb, struct RClass* cls) {
+  mrb_sym sym    = mrb_intern_lit(mrb, "$__cpp_classes__");
+  mrb_value hash = mrb_gv_get(mrb, sym);
+  if(mrb_nil_p(hash)) {
+      hash = mrb_hash_new(mrb);
+      mrb_gv_set(mrb, sym, hash);
+  }
+  size_t id      = typeid(typename std::decay<T>::type).hash_code();
+  mrb_value key  = mrb_fixnum_value(id);
+  mrb_hash_set(mrb, hash, key, mrb_obj_value(cls));
+}
+
+/// This function retrieves the MRuby class bound to C++ type T,
+/// or nullptr if the type has not been bound in this mrb_state
+template<typename T>
+struct RClass* get_cpp_class(mrb_state* mrb) {
+  mrb_sym sym    = mrb_intern_lit(mrb, "$__cpp_classes__");
+  mrb_value hash = mrb_gv_get(mrb, sym);
+  if(mrb_nil_p(hash)) return nullptr;
+  size_t id      = typeid(typename std::decay<T>::type).hash_code();
+  mrb_value key  = mrb_fixnum_value(id);
+  mrb_value val  = mrb_hash_get(mrb, hash, key);
+  if(mrb_nil_p(val)) return nullptr;
+  return mrb_class_ptr(val);
+}
+
 } // namespace detail
 
 } // namespace mrbind17
@@ -44,6 +44,14 @@ struct is_string {
     std::is_same<std::string, std::decay_t<T>>::value;
 };
 
+/// Checks if a type is a pointer to a class (e.g. a bound C++ class)
+template<typename T>
+struct is_class_pointer {
+  static constexpr bool value =
+    std::is_pointer<std::decay_t<T>>::value &&
+    std::is_class<std::remove_pointer_t<std::decay_t<T>>>::value;
+};
+
 /// Removes the class component in member function types,
 /// e.g. remove_class<R (C::*)(A...)>::type = R(A...)
 template<typename T>
@@ -59,6 +67,16 @@ struct remove_class<R (C::*)(A...) const> {
     typedef R type(A...);
 };
 
+template<typename C, typename R, typename... A>
+struct remove_class<R (C::*)(A...) noexcept> {
+    typedef R type(A...);
+};
+
+template<typename C, typename R, typename... A>
+struct remove_class<R (C::*)(A...) const noexcept> {
+    typedef R type(A...);
+};
+
 template<typename T>
 using remove_class_t = typename remove_class<T>::type;
 
@@ -0,0 +1,123 @@
+/*
+ Copyright (c) 2020 Matthieu Dorier <matthieu.dorier@gmail.com>
+ All rights reserved. Use of this source code is governed by a
+ BSD-style license that can be found in the LICENSE file.
+*/
+#ifndef MRBIND17_VARIABLE_H_
+#define MRBIND17_VARIABLE_H_
+
+#include <mrbind17/module.hpp>
+#include <mrbind17/symbol.hpp>
+#include <mrbind17/type_binder.hpp>
+#include <mruby.h>
+#include <mruby/variable.h>
+#include <string_view>
+
+namespace mrbind17 {
+
+/**
+ * @brief Handle to a global variable of an interpreter. The name is
+ * interned once when the handle is created; reads and writes then
+ * convert directly between the variable and a T.
+ *
+ * @tparam T C++ type of the variable's value.
+ */
+template<typename T>
+class global {
+
+  public:
+
+  global(const module& mod, static_name name)
+  : m_sym(mod.mrb(), name) {}
+
+  global(const module& mod, std::string_view name)
+  : m_sym(mod.mrb(), name) {}
+
+  global(const symbol& sym)
+  : m_sym(sym) {}
+
+  T get() const {
+    return detail::mrb_to_cpp<T>(m_sym.mrb(), mrb_gv_get(m_sym.mrb(), m_sym.id()));
+  }
+
+  void set(const T& val) {
+    mrb_gv_set(m_sym.mrb(), m_sym.id(), detail::cpp_to_mrb(m_sym.mrb(), val));
+  }
+
+  global& operator=(const T& val) {
+    set(val);
+    return *this;
+  }
+
+  operator T() const {
+    return get();
+  }
+
+  const symbol& sym() const {
+    return m_sym;
+  }
+
+  private:
+
+  symbol m_sym;
+};
+
+/**
+ * @brief Handle to a class variable of a module. As with module::cv_get,
+ * reading a variable that is not defined yields the conversion of nil.
+ *
+ * @tparam T C++ type of the variable's value.
+ */
+template<typename T>
+class class_var {
+
+  public:
+
+  class_var(const module& mod, static_name name)
+  : m_module(mod.rclass())
+  , m_sym(mod.mrb(), name) {}
+
+  class_var(const module& mod, std::string_view name)
+  : m_module(mod.rclass())
+  , m_sym(mod.mrb(), name) {}
+
+  class_var(const module& mod, const symbol& sym)
+  : m_module(mod.rclass())
+  , m_sym(sym) {}
+
+  bool defined() const {
+    return mrb_mod_cv_defined(m_sym.mrb(), m_module, m_sym.id());
+  }
+
+  T get() const {
+    mrb_state* mrb = m_sym.mrb();
+    if(!defined()) return detail::mrb_to_cpp<T>(mrb, mrb_nil_value());
+    return detail::mrb_to_cpp<T>(mrb, mrb_mod_cv_get(mrb, m_module, m_sym.id()));
+  }
+
+  void set(const T& val) {
+    mrb_mod_cv_set(m_sym.mrb(), m_module, m_sym.id(), detail::cpp_to_mrb(m_sym.mrb(), val));
+  }
+
+  class_var& operator=(const T& val) {
+    set(val);
+    return *this;
+  }
+
+  operator T() const {
+    return get();
+  }
+
+  const symbol& sym() const {
+    return m_sym;
+  }
+
+  private:
+
+  struct RClass* m_module;
+  symbol         m_sym;
+};
+
+}
+
+#endif
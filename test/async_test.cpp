@@ -0,0 +1,126 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace std::string_literals;
+
+class async_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( async_test );
+    CPPUNIT_TEST( test_value );
+    CPPUNIT_TEST( test_concurrent_calls );
+    CPPUNIT_TEST( test_wait_all );
+    CPPUNIT_TEST( test_exception );
+    CPPUNIT_TEST( test_invalid_future );
+    CPPUNIT_TEST( test_dropped_future );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_value() {
+        mrbind17::thread_pool pool(2);
+        mrbind17::interpreter mruby;
+        mruby.def_function("repeat", [](const std::string& s, int n) {
+            std::string result;
+            for(int i = 0; i < n; i++) result += s;
+            return result;
+        }, mrbind17::async_offload(pool));
+
+        CPPUNIT_ASSERT_EQUAL("ababab"s, mruby.execute("repeat('ab', 3).value").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL("Future"s, mruby.execute("repeat('ab', 3).class.to_s").as<std::string>());
+        // the value is converted once, then returned by further calls
+        CPPUNIT_ASSERT(mruby.execute("f = repeat('x', 2); f.value.equal?(f.value)").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("f = repeat('x', 2); f.wait.ready?").as<bool>());
+        // arguments are converted before the call is offloaded
+        CPPUNIT_ASSERT_THROW(mruby.execute("repeat(1, 2)"), std::bad_function_call);
+    }
+
+    void test_concurrent_calls() {
+        mrbind17::thread_pool pool(4);
+        mrbind17::interpreter mruby;
+        static std::mutex mutex;
+        static std::condition_variable cv;
+        static int running = 0;
+        // each call waits until all four calls are running
+        mruby.def_function("rendezvous", [](int x) {
+            std::unique_lock<std::mutex> lock(mutex);
+            running += 1;
+            cv.notify_all();
+            bool met = cv.wait_for(lock, std::chrono::seconds(10), []() { return running >= 4; });
+            return met ? x * 2 : -1;
+        }, mrbind17::async_offload(pool));
+
+        CPPUNIT_ASSERT_EQUAL(20, mruby.execute(
+            "fs = (1..4).map { |i| rendezvous(i) }\n"
+            "fs.map(&:value).inject(0) { |a, b| a + b }").as<int>());
+    }
+
+    void test_wait_all() {
+        mrbind17::thread_pool pool(3);
+        mrbind17::interpreter mruby;
+        mruby.def_function("square", [](int x) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(x % 3));
+            return x * x;
+        }, mrbind17::async_offload(pool));
+        mruby.def_function("touch", []() {}, mrbind17::async_offload(pool));
+
+        CPPUNIT_ASSERT_EQUAL(385, mruby.execute(
+            "Future.wait_all((1..10).map { |i| square(i) }).inject(0) { |a, b| a + b }").as<int>());
+        CPPUNIT_ASSERT_EQUAL(5, mruby.execute("Future.wait_all(square(1), square(2)).inject(:+)").as<int>());
+        CPPUNIT_ASSERT_EQUAL("[4, 9]"s, mruby.execute("Future.wait_all([square(2), square(3)]).inspect").as<std::string>());
+        CPPUNIT_ASSERT(mruby.execute("Future.wait_all([]).empty?").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("touch.value.nil?").as<bool>());
+    }
+
+    void test_exception() {
+        mrbind17::thread_pool pool(1);
+        mrbind17::interpreter mruby;
+        mruby.def_function("fail", [](int x) -> int {
+            throw std::runtime_error("failure " + std::to_string(x));
+        }, mrbind17::async_offload(pool));
+
+        mruby.execute("$f = fail(1)");
+        CPPUNIT_ASSERT_THROW(mruby.execute("$f.value"), std::runtime_error);
+        // collecting again rethrows the same exception
+        CPPUNIT_ASSERT_THROW(mruby.execute("$f.value"), std::runtime_error);
+    }
+
+    void test_invalid_future() {
+        mrbind17::thread_pool pool(1);
+        mrbind17::interpreter mruby;
+        mruby.def_function("touch", []() {}, mrbind17::async_offload(pool));
+        mruby.execute("touch.value");
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("Future.new"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("Future.wait_all([1])"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("Future.wait_all(nil)"), std::exception);
+        CPPUNIT_ASSERT_EQUAL("TypeError"s, mruby.execute(
+            "begin; Future.wait_all(touch, 2); rescue => e; e.class.to_s; end").as<std::string>());
+    }
+
+    void test_dropped_future() {
+        mrbind17::thread_pool pool(1);
+        static std::atomic<int> done = { 0 };
+        {
+            mrbind17::interpreter mruby;
+            mruby.def_function("slow", [](const std::string& s) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                done += s.size();
+            }, mrbind17::async_offload(pool));
+            mruby.execute("slow('abc'); nil");
+        }
+        // closing the interpreter waited for the task of the dropped future
+        CPPUNIT_ASSERT_EQUAL(3, done.load());
+    }
+
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( async_test );
@@ -0,0 +1,108 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <string_view>
+
+using namespace std::string_literals;
+
+static const char* last_data = nullptr;
+
+static mrbind17::byte_buffer make_blob(int size) {
+    mrbind17::byte_buffer buffer(size);
+    for(int i = 0; i < size; i++) buffer.data()[i] = 'a' + (i % 26);
+    last_data = buffer.data();
+    return buffer;
+}
+
+static bool consume_blob(mrbind17::byte_buffer buffer) {
+    return buffer.data() == last_data;
+}
+
+static bool take_blob(mrbind17::string_handle handle, int) {
+    return handle.take().data() == last_data;
+}
+
+class byte_buffer_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( byte_buffer_test );
+    CPPUNIT_TEST( test_byte_buffer );
+    CPPUNIT_TEST( test_return_buffer );
+    CPPUNIT_TEST( test_pass_buffer );
+    CPPUNIT_TEST( test_string_view );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_byte_buffer() {
+        mrbind17::byte_buffer buffer;
+        CPPUNIT_ASSERT(buffer.empty());
+        buffer.append("hello", 5);
+        buffer.append(" world", 6);
+        CPPUNIT_ASSERT_EQUAL("hello world"s, std::string(buffer.view()));
+        CPPUNIT_ASSERT_EQUAL('\0', buffer.data()[buffer.size()]);
+        buffer.resize(5);
+        CPPUNIT_ASSERT_EQUAL("hello"s, std::string(buffer.data()));
+
+        mrbind17::byte_buffer moved(std::move(buffer));
+        CPPUNIT_ASSERT(buffer.empty());
+        CPPUNIT_ASSERT_EQUAL((size_t)5, moved.size());
+    }
+
+    void test_return_buffer() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("make_blob", make_blob);
+
+        CPPUNIT_ASSERT_EQUAL(1 << 20, mruby.execute("make_blob(1 << 20).size").as<int>());
+        CPPUNIT_ASSERT_EQUAL("abcdefghijklmnopqrstuvwxyzab"s,
+                             mruby.execute("make_blob(28)").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(""s, mruby.execute("make_blob(0)").as<std::string>());
+        CPPUNIT_ASSERT(mruby.execute("b = make_blob(100); b << 'xyz'; b[-3..-1] == 'xyz'").as<bool>());
+    }
+
+    void test_pass_buffer() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("make_blob", make_blob);
+        mruby.def_function("consume_blob", consume_blob);
+        mruby.def_function("take_blob", take_blob);
+
+        // byte_buffer arguments are copies, the Ruby string is unchanged
+        CPPUNIT_ASSERT(!mruby.execute("$b = make_blob(100000); consume_blob($b)").as<bool>());
+        CPPUNIT_ASSERT_EQUAL(100000, mruby.execute("$b.size").as<int>());
+
+        // taking the bytes of a string_handle moves them back to C++
+        // without copying, leaving the Ruby string empty
+        CPPUNIT_ASSERT(mruby.execute("$b = make_blob(100000); take_blob($b, 1)").as<bool>());
+        CPPUNIT_ASSERT_EQUAL(0, mruby.execute("$b.size").as<int>());
+
+        // a failed call leaves the string untouched
+        CPPUNIT_ASSERT_THROW(mruby.execute("$b = make_blob(100000); take_blob($b, 'x')"), std::exception);
+        CPPUNIT_ASSERT_EQUAL(100000, mruby.execute("$b.size").as<int>());
+
+        // frozen strings are copied
+        CPPUNIT_ASSERT(!mruby.execute("$b = make_blob(100000).freeze; take_blob($b, 1)").as<bool>());
+        CPPUNIT_ASSERT_EQUAL(100000, mruby.execute("$b.size").as<int>());
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("consume_blob(42)"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("take_blob(42, 1)"), std::exception);
+    }
+
+    void test_string_view() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("view_size", [](std::string_view s) { return s.size(); });
+        mruby.def_function("same_bytes", [](std::string_view a, std::string_view b) {
+            return a.data() == b.data();
+        });
+        mruby.def_function("echo", [](std::string_view s) { return s; });
+
+        CPPUNIT_ASSERT_EQUAL(5, mruby.execute("view_size('hello')").as<int>());
+        CPPUNIT_ASSERT_EQUAL(4, mruby.execute("view_size(:name)").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("s = 'x' * 1000; same_bytes(s, s)").as<bool>());
+        CPPUNIT_ASSERT_EQUAL("abc"s, mruby.execute("echo('abc')").as<std::string>());
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( byte_buffer_test );
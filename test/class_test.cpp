@@ -0,0 +1,141 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <iostream>
+
+using namespace std::string_literals;
+
+struct point {
+    double x = 0.0;
+    double y = 0.0;
+    std::string label;
+    int id = 42;
+};
+
+class class_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( class_test );
+    CPPUNIT_TEST( test_def_class );
+    CPPUNIT_TEST( test_def_readwrite );
+    CPPUNIT_TEST( test_def_readonly );
+    CPPUNIT_TEST( test_pass_instances );
+    CPPUNIT_TEST( test_wrong_field_type );
+    CPPUNIT_TEST( test_wrong_instance_type );
+    CPPUNIT_TEST( test_pointer_identity );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_def_class() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_class<point>("Point");
+
+        std::string code = R"ruby(
+            Point.new
+        )ruby";
+
+        CPPUNIT_ASSERT_NO_THROW(mruby.execute(code.c_str()));
+    }
+
+    void test_def_readwrite() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_class<point>("Point")
+             .def_readwrite("x", &point::x)
+             .def_readwrite("y", &point::y)
+             .def_readwrite("label", &point::label);
+
+        std::string code = R"ruby(
+            p = Point.new
+            p.x = 1.5
+            p.y = 2
+            p.label = "origin"
+            p
+        )ruby";
+
+        auto p = mruby.execute(code.c_str()).as<point>();
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.5, p.x, 1e-9);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, p.y, 1e-9);
+        CPPUNIT_ASSERT_EQUAL("origin"s, p.label);
+    }
+
+    void test_def_readonly() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_class<point>("Point")
+             .def_readonly("id", &point::id);
+
+        CPPUNIT_ASSERT_EQUAL(42, mruby.execute("Point.new.id").as<int>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("Point.new.id = 3"), std::runtime_error);
+    }
+
+    void test_pass_instances() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_class<point>("Point")
+             .def_readwrite("x", &point::x)
+             .def_readwrite("y", &point::y);
+        mruby.def_function("make_point", [](double x, double y) { return point{x, y}; });
+        mruby.def_function("norm2", [](const point& p) { return p.x*p.x + p.y*p.y; });
+        mruby.def_function("scale", [](point& p, double f) { p.x *= f; p.y *= f; });
+        mruby.def_function("scaled", [](point p, double f) { p.x *= f; p.y *= f; return p; });
+
+        std::string code = R"ruby(
+            p = make_point(3, 4)
+            q = scaled(p, 10)
+            scale(p, 2)
+            p.x + p.y + norm2(p) + q.x
+        )ruby";
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(144.0, mruby.execute(code.c_str()).as<double>(), 1e-9);
+        CPPUNIT_ASSERT_THROW(mruby.execute("scale(1, 2)"), std::bad_function_call);
+    }
+
+    void test_wrong_field_type() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_class<point>("Point")
+             .def_readwrite("x", &point::x);
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("Point.new.x = 'abc'"), std::runtime_error);
+    }
+
+    void test_wrong_instance_type() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_class<point>("Point");
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("42").as<point>(), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(mruby.execute("Object.new").as<point>(), std::invalid_argument);
+    }
+
+    void test_pointer_identity() {
+        mrbind17::interpreter mruby;
+        static point nodes[3] = { {0, 0}, {1, 0}, {2, 0} };
+
+        mruby.def_class<point>("Point")
+             .def_readwrite("x", &point::x);
+        mruby.def_function("node", [](int i) { return &nodes[i]; });
+        mruby.def_function("copy", [](int i) { return nodes[i]; });
+
+        CPPUNIT_ASSERT(mruby.execute("node(1).equal?(node(1))").as<bool>());
+        CPPUNIT_ASSERT(!mruby.execute("node(1).equal?(node(2))").as<bool>());
+        // values are copied into new objects
+        CPPUNIT_ASSERT(!mruby.execute("copy(1).equal?(copy(1))").as<bool>());
+
+        // wrappers are forgotten when collected
+        mruby.execute("1000.times { |i| node(i % 3) }; nil");
+        CPPUNIT_ASSERT(mrbind17::detail::get_state(mruby.mrb())->wrappers.size() <= 3);
+        mruby.full_gc();
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2.0, mruby.execute("node(2).x").as<double>(), 1e-9);
+        CPPUNIT_ASSERT(mruby.execute("a = node(0); a.x = 5; node(0).x == 5").as<bool>());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0, nodes[0].x, 1e-9);
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( class_test );
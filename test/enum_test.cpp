@@ -0,0 +1,100 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+
+using namespace std::string_literals;
+
+enum class job_state { idle, running, done, failed = 10 };
+
+enum flags : unsigned { none = 0, readable = 1, writable = 1 << 8, executable = 1 << 20 };
+
+static job_state next_state(job_state s) {
+    switch(s) {
+        case job_state::idle:    return job_state::running;
+        case job_state::running: return job_state::done;
+        default:                 return job_state::failed;
+    }
+}
+
+class enum_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( enum_test );
+    CPPUNIT_TEST( test_def_enum );
+    CPPUNIT_TEST( test_invalid_symbol );
+    CPPUNIT_TEST( test_sparse_enum );
+    CPPUNIT_TEST( test_unregistered_value );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_def_enum() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_enum<job_state>("job_state", {
+            { "idle",    job_state::idle },
+            { "running", job_state::running },
+            { "done",    job_state::done },
+            { "failed",  job_state::failed }
+        });
+        mruby.def_function("next_state", next_state);
+
+        CPPUNIT_ASSERT(mruby.execute("next_state(:idle) == :running").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("next_state(next_state(:idle)) == :done").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("next_state(:done) == :failed").as<bool>());
+        CPPUNIT_ASSERT(job_state::failed == mruby.execute(":failed").as<job_state>());
+
+        mruby.set_global("$state", job_state::running);
+        CPPUNIT_ASSERT(mruby.execute("$state == :running").as<bool>());
+    }
+
+    void test_invalid_symbol() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_enum<job_state>("job_state", {
+            { "idle",    job_state::idle },
+            { "running", job_state::running }
+        });
+        mruby.def_function("next_state", next_state);
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("next_state(:sleeping)"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("next_state('idle')"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("next_state(0)"), std::exception);
+    }
+
+    void test_sparse_enum() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_enum<flags>("flags", {
+            { "none",       none },
+            { "readable",   readable },
+            { "writable",   writable },
+            { "executable", executable }
+        });
+        mruby.def_function("combine", [](flags a, flags b) {
+            return static_cast<unsigned>(a) | static_cast<unsigned>(b);
+        });
+        mruby.def_function("executable", []() { return executable; });
+
+        CPPUNIT_ASSERT_EQUAL(static_cast<int>(readable | executable),
+                             mruby.execute("combine(:readable, :executable)").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("executable == :executable").as<bool>());
+    }
+
+    void test_unregistered_value() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_enum<job_state>("job_state", {
+            { "idle", job_state::idle }
+        });
+        mruby.def_function("next_state", next_state);
+
+        // values without a name are converted into integers
+        CPPUNIT_ASSERT_EQUAL(1, mruby.execute("next_state(:idle)").as<int>());
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( enum_test );
@@ -0,0 +1,70 @@
+#include <mrbind17/mrbind17.hpp>
+#include <mrbind17/executor.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <vector>
+#include <future>
+#include <iostream>
+
+using namespace std::string_literals;
+
+class executor_test : public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE( executor_test );
+  CPPUNIT_TEST( test_submit );
+  CPPUNIT_TEST( test_submit_args );
+  CPPUNIT_TEST( test_setup );
+  CPPUNIT_TEST( test_script_error );
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+
+  void setUp() {}
+  void tearDown() {}
+
+  void test_submit() {
+    mrbind17::executor exec({}, 4);
+
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 100; i++)
+      results.push_back(exec.submit<int>("(1..10).reduce(:+)"));
+    for(auto& r : results)
+      CPPUNIT_ASSERT_EQUAL(55, r.get());
+  }
+
+  void test_submit_args() {
+    mrbind17::executor exec({}, 2);
+
+    auto r1 = exec.submit<int>("$args[0] * $args[1]", 6, 7);
+    auto r2 = exec.submit<std::string>("$args[0] + $args[1]", "Hello "s, "World");
+    auto r3 = exec.submit<void>("$args.size");
+    CPPUNIT_ASSERT_EQUAL(42, r1.get());
+    CPPUNIT_ASSERT_EQUAL("Hello World"s, r2.get());
+    CPPUNIT_ASSERT_NO_THROW(r3.get());
+  }
+
+  void test_setup() {
+    mrbind17::executor exec([](mrbind17::interpreter& mruby) {
+        mruby.def_function("twice", [](int x) { return 2*x; });
+        mruby.def_const("FACTOR", 3);
+    }, 3);
+
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 30; i++)
+      results.push_back(exec.submit<int>("twice($args[0]) * FACTOR", i));
+    for(int i = 0; i < 30; i++)
+      CPPUNIT_ASSERT_EQUAL(6*i, results[i].get());
+  }
+
+  void test_script_error() {
+    mrbind17::executor exec({}, 1);
+
+    auto r1 = exec.submit<int>("UNDEFINED_CONSTANT");
+    auto r2 = exec.submit<int>("42");
+    CPPUNIT_ASSERT_THROW(r1.get(), std::runtime_error);
+    CPPUNIT_ASSERT_EQUAL(42, r2.get());
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( executor_test );
@@ -43,6 +43,14 @@ class function_test : public CppUnit::TestFixture {
     CPPUNIT_TEST( test_def_std_function );
     CPPUNIT_TEST( test_def_lambda );
     CPPUNIT_TEST( test_def_function_object );
+    CPPUNIT_TEST( test_no_allocation_per_call );
+    CPPUNIT_TEST( test_memoize );
+    CPPUNIT_TEST( test_memoize_eviction );
+    CPPUNIT_TEST( test_memoize_reentrant );
+    CPPUNIT_TEST( test_block );
+    CPPUNIT_TEST( test_block_exception );
+    CPPUNIT_TEST( test_block_break );
+    CPPUNIT_TEST( test_infallible );
     //CPPUNIT_TEST( test_overload );
     CPPUNIT_TEST_SUITE_END();
 
@@ -166,6 +174,78 @@ class function_test : public CppUnit::TestFixture {
         CPPUNIT_ASSERT_NO_THROW(mruby.execute(code.c_str()));
     }
 
+    void test_no_allocation_per_call() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_function("add", [](int x, int y) { return x + y; });
+        mruby.execute("$total = 0; add(1, 2)");
+
+        auto guard = mruby.disable_gc();
+        auto before = mruby.get_gc_stats().live_objects;
+        mruby.execute("$total = 0; i = 0; while i < 10000; $total = add($total, 1); i += 1; end");
+        auto after = mruby.get_gc_stats().live_objects;
+
+        CPPUNIT_ASSERT_EQUAL(10000, mruby.get_global<int>("$total"));
+        CPPUNIT_ASSERT(after - before < 100);
+    }
+
+    void test_memoize() {
+        mrbind17::interpreter mruby;
+
+        int calls = 0;
+        mruby.def_function("rate_for", [&calls](const std::string& region, int tier) {
+            calls += 1;
+            return region + std::to_string(tier);
+        }, mrbind17::pure());
+        mruby.def_function("identity", [&calls](mrbind17::object o) {
+            calls += 1;
+            return o;
+        }, mrbind17::memoize(16));
+
+        std::string code = R"ruby(
+            r = []
+            100.times { r << rate_for("eu", 1) }
+            r << rate_for("eu", 2) << rate_for(:eu, 2)
+            r[0] << "!"
+            r[1]
+        )ruby";
+
+        CPPUNIT_ASSERT_EQUAL("eu1"s, mruby.execute(code.c_str()).as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(3, calls);
+
+        // arguments that cannot be used as keys bypass the cache
+        calls = 0;
+        mruby.execute("identity([1]); identity([1]); identity(1); identity(1)");
+        CPPUNIT_ASSERT_EQUAL(3, calls);
+
+        calls = 0;
+        mruby.clear_memoized("rate_for");
+        mruby.execute("rate_for('eu', 1); rate_for('eu', 1); identity(1)");
+        CPPUNIT_ASSERT_EQUAL(1, calls);
+        mruby.clear_memoized();
+        mruby.execute("identity(1)");
+        CPPUNIT_ASSERT_EQUAL(2, calls);
+    }
+
+    void test_memoize_eviction() {
+        mrbind17::interpreter mruby;
+
+        int calls = 0;
+        mruby.def_function("square", [&calls](int x) {
+            calls += 1;
+            return x * x;
+        }, mrbind17::memoize(2));
+
+        mruby.execute("square(1); square(2); square(1); square(3)"); // evicts 2
+        CPPUNIT_ASSERT_EQUAL(3, calls);
+        CPPUNIT_ASSERT_EQUAL(1, mruby.execute("square(1)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(3, calls);
+        CPPUNIT_ASSERT_EQUAL(4, mruby.execute("square(2)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(4, calls);
+        mruby.full_gc();
+        CPPUNIT_ASSERT_EQUAL(9, mruby.execute("square(3)").as<int>());
+    }
+
     void test_overload() {
         mrbind17::interpreter mruby;
 
@@ -180,6 +260,148 @@ class function_test : public CppUnit::TestFixture {
         CPPUNIT_ASSERT_NO_THROW(mruby.execute(code.c_str()));
 
     }
+    void test_memoize_reentrant() {
+        mrbind17::interpreter mruby;
+
+        int calls = 0;
+        mruby.def_function("digits", [&mruby, &calls](int n) {
+            calls += 1;
+            if(n == 0) return 0;
+            // calls the same memoized function before storing the result
+            auto code = "digits(" + std::to_string(n - 1) + ")";
+            return n + 10 * mruby.execute(code.c_str()).as<int>();
+        }, mrbind17::pure());
+
+        CPPUNIT_ASSERT_EQUAL(123, mruby.execute("digits(3)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(4, calls);
+        CPPUNIT_ASSERT_EQUAL(123, mruby.execute("digits(3)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(12, mruby.execute("digits(2)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(1, mruby.execute("digits(1)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(0, mruby.execute("digits(0)").as<int>());
+        CPPUNIT_ASSERT_EQUAL(4, calls);
+    }
+
+    void test_block() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_function("scan", [](int n, mrbind17::block blk) {
+            for(int i = 0; i < n; i++) blk.yield(i, "row " + std::to_string(i));
+            return n;
+        });
+        mruby.def_function("sum_mapped", [](int n, mrbind17::block blk) {
+            int total = 0;
+            for(int i = 0; i < n; i++) total += blk.yield<int>(i);
+            return total;
+        });
+        mruby.def_function("block_given", [](mrbind17::block blk) {
+            return static_cast<bool>(blk);
+        });
+
+        std::string code = R"ruby(
+            $count = 0
+            $last = nil
+            scan(100000) { |i, row| $count += 1; $last = row }
+        )ruby";
+        CPPUNIT_ASSERT_EQUAL(100000, mruby.execute(code.c_str()).as<int>());
+        CPPUNIT_ASSERT_EQUAL(100000, mruby.execute("$count").as<int>());
+        CPPUNIT_ASSERT_EQUAL("row 99999"s, mruby.execute("$last").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(20, mruby.execute("sum_mapped(5) { |i| i * 2 }").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("block_given { }").as<bool>());
+        CPPUNIT_ASSERT(!mruby.execute("block_given").as<bool>());
+
+        // the block does not count as an argument
+        CPPUNIT_ASSERT_THROW(mruby.execute("scan(1, 2) { }"), std::exception);
+    }
+
+    void test_block_exception() {
+        mrbind17::interpreter mruby;
+        static int destroyed = 0;
+        struct guard { ~guard() { destroyed++; } };
+
+        mruby.def_function("scan", [](int n, mrbind17::block blk) {
+            guard g;
+            for(int i = 0; i < n; i++) blk.yield(i);
+        });
+
+        std::string code = R"ruby(
+            seen = []
+            begin
+              scan(10) { |i| seen << i; raise "stop" if i == 3 }
+            rescue => e
+              seen << e.message
+            end
+            seen.size
+        )ruby";
+        CPPUNIT_ASSERT_EQUAL(5, mruby.execute(code.c_str()).as<int>());
+        CPPUNIT_ASSERT_EQUAL(1, destroyed);
+
+        // yielding without a block raises LocalJumpError
+        CPPUNIT_ASSERT_THROW(mruby.execute("scan(1)"), std::exception);
+        CPPUNIT_ASSERT_EQUAL(2, destroyed);
+    }
+
+    void test_block_break() {
+        mrbind17::interpreter mruby;
+        static int destroyed = 0;
+        static int yielded = 0;
+        struct guard { ~guard() { destroyed++; } };
+
+        mruby.def_function("scan", [](int n, mrbind17::block blk) {
+            guard g;
+            for(int i = 0; i < n; i++) { yielded++; blk.yield(i); }
+            return n;
+        });
+
+        CPPUNIT_ASSERT(mruby.execute("scan(1000) { |r| break }.nil?").as<bool>());
+        CPPUNIT_ASSERT_EQUAL(1, yielded);
+        CPPUNIT_ASSERT_EQUAL(1, destroyed);
+
+        // break returns its value from the call, and the script goes on
+        std::string code = R"ruby(
+            found = scan(1000) { |r| break r * 10 if r == 4 }
+            [found, scan(3) { }].inspect
+        )ruby";
+        CPPUNIT_ASSERT_EQUAL("[40, 3]"s, mruby.execute(code.c_str()).as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(1 + 5 + 3, yielded);
+        CPPUNIT_ASSERT_EQUAL(3, destroyed);
+
+        // breaking from a nested loop only exits the inner scan
+        CPPUNIT_ASSERT_EQUAL(6, mruby.execute(
+            "t = 0; scan(3) { |i| scan(10) { |j| break if j > i; t += 1 } }; t").as<int>());
+    }
+
+    void test_infallible() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("choose", [](bool b, mrb_value x, mrb_value y) noexcept {
+            return b ? x : y;
+        });
+        mruby.def_function("negate", [](bool b) noexcept { return !b; });
+        static int calls = 0;
+        mruby.def_function("touch", [](mrbind17::object) noexcept { calls++; });
+
+        CPPUNIT_ASSERT_EQUAL("a"s, mruby.execute("choose(true, 'a', 1)").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(1, mruby.execute("choose(nil, 'a', 1)").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("negate(nil)").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("touch([1, 2]).nil?").as<bool>());
+        CPPUNIT_ASSERT_EQUAL(1, calls);
+
+        // the number of arguments is still checked, reported
+        // as for the other bindings
+        CPPUNIT_ASSERT_THROW(mruby.execute("negate(true, false)"), std::bad_function_call);
+        CPPUNIT_ASSERT_THROW(mruby.execute("choose(true)"), std::bad_function_call);
+
+        // capturing lambdas are called through their std::function
+        int captured = 0;
+        mruby.def_function("count", [&captured](mrb_value) noexcept { return ++captured; });
+        CPPUNIT_ASSERT_EQUAL(2, mruby.execute("count(1); count(nil)").as<int>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("count"), std::bad_function_call);
+
+        // noexcept functions with checked arguments keep the generic path
+        mruby.def_function("twice", [](int x) noexcept { return 2 * x; });
+        CPPUNIT_ASSERT_EQUAL(6, mruby.execute("twice(3)").as<int>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("twice('a')"), std::bad_function_call);
+    }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( function_test );
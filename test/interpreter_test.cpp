@@ -1,7 +1,12 @@
 #include <mrbind17/mrbind17.hpp>
 #include <cppunit/extensions/HelperMacros.h>
 #include <string>
+#include <chrono>
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -14,6 +19,17 @@ class interpreter_test : public CppUnit::TestFixture {
   CPPUNIT_TEST( test_def_const );
   CPPUNIT_TEST( test_undefined_const );
   CPPUNIT_TEST( test_def_global );
+  CPPUNIT_TEST( test_global_handle );
+  CPPUNIT_TEST( test_gc_tuning );
+  CPPUNIT_TEST( test_gc_control );
+  CPPUNIT_TEST( test_execute_stream );
+  CPPUNIT_TEST( test_execute_file );
+  CPPUNIT_TEST( test_compile_context );
+  CPPUNIT_TEST( test_checkpoint_reset );
+  CPPUNIT_TEST( test_core_only );
+  CPPUNIT_TEST( test_autoload );
+  CPPUNIT_TEST( test_autoload_failure );
+  CPPUNIT_TEST( test_autoload_top_level );
   CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -73,6 +89,43 @@ class interpreter_test : public CppUnit::TestFixture {
     CPPUNIT_ASSERT_NO_THROW(mruby.execute(code.c_str()));
   }
 
+  void test_global_handle() {
+    mrbind17::interpreter mruby;
+
+    mrbind17::global<int> counter(mruby, "$counter");
+    mrbind17::global<std::string> name(mruby, "$name");
+    counter = 41;
+    name = "Matthieu"s;
+
+    std::string code = R"ruby(
+      $counter += 1
+      $name = $name + " Dorier"
+    )ruby";
+
+    CPPUNIT_ASSERT_NO_THROW(mruby.execute(code.c_str()));
+    CPPUNIT_ASSERT_EQUAL(42, counter.get());
+    CPPUNIT_ASSERT_EQUAL("Matthieu Dorier"s, name.get());
+
+    auto sym = mruby.intern("$counter");
+    CPPUNIT_ASSERT_EQUAL(42, mruby.get_global<int>(sym));
+    mruby.set_global(sym, 43);
+    CPPUNIT_ASSERT_EQUAL(43, static_cast<int>(counter));
+
+    using namespace mrbind17::literals;
+    CPPUNIT_ASSERT(mruby.intern("$counter"_name) == sym);
+    mrbind17::global<int> literal(mruby, "$counter"_name);
+    CPPUNIT_ASSERT_EQUAL(43, literal.get());
+
+    // character arrays are copied, up to their first null character
+    mrbind17::symbol copied(mruby.mrb(), mrb_sym(0));
+    {
+      const char buf[64] = "$counter";
+      copied = mruby.intern(buf);
+    }
+    CPPUNIT_ASSERT("$counter"s == copied.name());
+    CPPUNIT_ASSERT(copied == sym);
+  }
+
   void test_undefined_const() {
     mrbind17::interpreter mruby;
 
@@ -82,6 +135,249 @@ class interpreter_test : public CppUnit::TestFixture {
     CPPUNIT_ASSERT_THROW(mruby.execute(code.c_str()), std::runtime_error);
   }
 
+  void test_gc_tuning() {
+    mrbind17::interpreter mruby;
+
+    mruby.set_gc_mode(mrbind17::gc_mode::generational);
+    CPPUNIT_ASSERT(mruby.get_gc_mode() == mrbind17::gc_mode::generational);
+    CPPUNIT_ASSERT(mruby.execute("GC.generational_mode").as<bool>());
+    mruby.set_gc_mode(mrbind17::gc_mode::incremental);
+    CPPUNIT_ASSERT(mruby.get_gc_mode() == mrbind17::gc_mode::incremental);
+
+    mruby.set_gc_interval_ratio(150);
+    mruby.set_gc_step_ratio(300);
+    CPPUNIT_ASSERT_EQUAL(150, mruby.get_gc_interval_ratio());
+    CPPUNIT_ASSERT_EQUAL(300, mruby.execute("GC.step_ratio").as<int>());
+  }
+
+  void test_gc_control() {
+    mrbind17::interpreter mruby;
+
+    std::string code = R"ruby(
+      $keep = (1..1000).map { |i| "string #{i}" }
+      10000.times { |i| "garbage #{i}" }
+    )ruby";
+
+    {
+      auto guard = mruby.disable_gc();
+      CPPUNIT_ASSERT(mruby.get_gc_stats().disabled);
+      CPPUNIT_ASSERT(!mruby.gc_step(std::chrono::milliseconds(10)));
+      mruby.execute(code.c_str());
+    }
+    auto before = mruby.get_gc_stats();
+    CPPUNIT_ASSERT(!before.disabled);
+    CPPUNIT_ASSERT_EQUAL((size_t)0, before.collections);
+    CPPUNIT_ASSERT(before.heap_pages > 0);
+
+    // With a generous budget, the cycle completes
+    CPPUNIT_ASSERT(mruby.gc_step(std::chrono::seconds(10)));
+    mruby.full_gc();
+    auto after = mruby.get_gc_stats();
+    CPPUNIT_ASSERT_EQUAL((size_t)2, after.collections);
+    CPPUNIT_ASSERT(after.live_objects < before.live_objects);
+    CPPUNIT_ASSERT(after.live_objects > 1000);
+    CPPUNIT_ASSERT(after.max_pause >= after.last_pause);
+    CPPUNIT_ASSERT(after.total_pause >= after.max_pause);
+    CPPUNIT_ASSERT_EQUAL(1000, mruby.execute("$keep.size").as<int>());
+  }
+
+  void test_execute_stream() {
+    mrbind17::interpreter mruby;
+
+    std::stringstream ss;
+    ss << "$total = 0\n";
+    for(int i = 0; i < 10000; i++)
+      ss << "$total += " << i << "\n";
+    ss << "$total\n";
+    CPPUNIT_ASSERT_EQUAL(49995000, mruby.execute(ss).as<int>());
+
+    std::istringstream bad("def broken(\n");
+    CPPUNIT_ASSERT_THROW(mruby.execute(bad), std::exception);
+  }
+
+  void test_execute_file() {
+    mrbind17::interpreter mruby;
+
+    std::string path = "interpreter_test_script.rb";
+    {
+      std::ofstream f(path);
+      f << "def triple(x)\n  x * 3\nend\n";
+      f << "triple(14)\n";
+    }
+    CPPUNIT_ASSERT_EQUAL(42, mruby.execute_file(path).as<int>());
+    CPPUNIT_ASSERT_EQUAL(9, mruby.execute("triple(3)").as<int>());
+    std::remove(path.c_str());
+
+    CPPUNIT_ASSERT_THROW(mruby.execute_file("does_not_exist.rb"), std::runtime_error);
+  }
+
+  void test_compile_context() {
+    mrbind17::interpreter mruby;
+    mrbind17::compile_context cxt(mruby.mrb(), "rules.rb");
+    CPPUNIT_ASSERT_EQUAL("rules.rb"s, cxt.get_filename());
+
+    mruby.execute("a = 20", cxt);
+    mruby.execute("b = a + 1", cxt);
+    std::istringstream ss("c = b * 2\nc");
+    CPPUNIT_ASSERT_EQUAL(42, mruby.execute(ss, cxt).as<int>());
+    CPPUNIT_ASSERT_EQUAL((size_t)3, cxt.num_locals());
+    CPPUNIT_ASSERT_EQUAL(83, mruby.execute("a + b + c", cxt).as<int>());
+
+    // without the context, the locals are not visible
+    CPPUNIT_ASSERT_THROW(mruby.execute("a"), std::exception);
+  }
+
+  void test_checkpoint_reset() {
+    mrbind17::interpreter mruby;
+    CPPUNIT_ASSERT_THROW(mruby.reset(), std::runtime_error);
+
+    mruby.def_function("answer", []() { return 42; });
+    mruby.set_global("$limit", 10);
+    mruby.def_const("VERSION", 3);
+    mruby.execute("class Rule; def score; 1; end; end");
+    mruby.checkpoint();
+
+    std::string script = R"ruby(
+      $limit = 20
+      $scratch = [1, 2, 3]
+      VERSION = 4
+      @top = 1
+      def helper; 5; end
+      def answer; 0; end
+      class Rule; def score; 2; end; def extra; end; end
+      class Temporary; end
+      module Plugins; end
+      String.class_eval { def shout; upcase; end }
+      helper + answer
+    )ruby";
+
+    CPPUNIT_ASSERT_EQUAL(5, mruby.execute(script.c_str()).as<int>());
+    mruby.reset();
+
+    CPPUNIT_ASSERT_EQUAL(42, mruby.execute("answer").as<int>());
+    CPPUNIT_ASSERT_EQUAL(10, mruby.execute("$limit").as<int>());
+    CPPUNIT_ASSERT(mruby.execute("$scratch.nil?").as<bool>());
+    CPPUNIT_ASSERT_EQUAL(3, mruby.execute("VERSION").as<int>());
+    CPPUNIT_ASSERT(mruby.execute("@top.nil?").as<bool>());
+    CPPUNIT_ASSERT_EQUAL(1, mruby.execute("Rule.new.score").as<int>());
+    CPPUNIT_ASSERT(!mruby.execute("Rule.new.respond_to?(:extra)").as<bool>());
+    CPPUNIT_ASSERT(!mruby.execute("Object.const_defined?(:Temporary)").as<bool>());
+    CPPUNIT_ASSERT(!mruby.execute("Object.const_defined?(:Plugins)").as<bool>());
+    CPPUNIT_ASSERT(!mruby.execute("'a'.respond_to?(:shout)").as<bool>());
+    CPPUNIT_ASSERT_THROW(mruby.execute("helper"), std::exception);
+
+    // the interpreter can be reset any number of times
+    for(int i = 0; i < 3; i++) {
+      CPPUNIT_ASSERT_EQUAL(5, mruby.execute(script.c_str()).as<int>());
+      mruby.reset();
+    }
+    CPPUNIT_ASSERT_EQUAL(42, mruby.execute("answer").as<int>());
+  }
+
+  void test_core_only() {
+    mrbind17::interpreter_options full_options;
+    full_options.track_memory = true;
+    mrbind17::interpreter full(full_options);
+
+    mrbind17::interpreter_options core_options;
+    core_options.core_only    = true;
+    core_options.track_memory = true;
+    mrbind17::interpreter core(core_options);
+
+    core.def_function("twice", [](int x) { return 2*x; });
+    CPPUNIT_ASSERT_EQUAL(42, core.execute("twice(20) + 2").as<int>());
+
+    auto full_stats = full.get_memory_stats();
+    auto core_stats = core.get_memory_stats();
+    CPPUNIT_ASSERT(core_stats.current_bytes > 0);
+    CPPUNIT_ASSERT(core_stats.peak_bytes >= core_stats.current_bytes);
+    CPPUNIT_ASSERT(core_stats.current_bytes <= full_stats.current_bytes);
+
+    mrbind17::interpreter untracked;
+    CPPUNIT_ASSERT_EQUAL((size_t)0, untracked.get_memory_stats().current_bytes);
+  }
+
+  void test_autoload() {
+    mrbind17::interpreter mruby;
+    mruby.autoload("Greeter", "module Greeter; def self.hello; 'hello'; end; end");
+    mruby.autoload("Rules", "module Rules; end");
+    mruby.autoload("Rules::Pricing", "module Rules::Pricing; def self.rate; Rules::Discount::VALUE + 1; end; end");
+    mruby.autoload("Rules::Discount", "module Rules::Discount; VALUE = 2; end");
+    mruby.autoload("Unused", "raise 'should not be loaded'");
+
+    std::string path = "interpreter_test_autoload.rb";
+    {
+      std::ofstream f(path);
+      f << "class Counter\n  def self.start; 10; end\nend\n";
+    }
+    mruby.autoload_file("Counter", path);
+
+    CPPUNIT_ASSERT(mruby.autoloaded().empty());
+    CPPUNIT_ASSERT_EQUAL("hello"s, mruby.execute("Greeter.hello").as<std::string>());
+    CPPUNIT_ASSERT_EQUAL(3, mruby.execute("Rules::Pricing.rate").as<int>());
+    // libraries are only loaded once
+    CPPUNIT_ASSERT_EQUAL(3, mruby.execute("module Rules; Pricing.rate; end").as<int>());
+    CPPUNIT_ASSERT_EQUAL(10, mruby.execute("Counter.start").as<int>());
+    std::remove(path.c_str());
+
+    std::vector<std::string> expected = { "Greeter", "Rules", "Rules::Pricing", "Rules::Discount", "Counter" };
+    CPPUNIT_ASSERT(expected == mruby.autoloaded());
+    CPPUNIT_ASSERT_THROW(mruby.execute("Missing"), std::runtime_error);
+
+    // libraries loaded after a checkpoint are loaded again after a reset
+    mrbind17::interpreter other;
+    other.autoload("Greeter", "module Greeter; def self.hello; 'hi'; end; end");
+    other.checkpoint();
+    CPPUNIT_ASSERT_EQUAL("hi"s, other.execute("Greeter.hello").as<std::string>());
+    other.reset();
+    CPPUNIT_ASSERT(other.autoloaded().empty());
+    CPPUNIT_ASSERT_EQUAL("hi"s, other.execute("Greeter.hello").as<std::string>());
+  }
+
+  void test_autoload_failure() {
+    mrbind17::interpreter mruby;
+    mruby.autoload("Broken", "raise 'broken library'");
+    mruby.autoload("Flaky", "$tries = ($tries || 0) + 1\n"
+                            "raise 'not yet' if $tries < 2\n"
+                            "module Flaky; TRIES = $tries; end");
+    mruby.autoload("Invalid", "module Invalid; end end");
+
+    // a library raising an exception is tried again by later references
+    CPPUNIT_ASSERT_EQUAL("broken library"s, mruby.execute(
+      "begin; Broken; rescue => e; e.message; end").as<std::string>());
+    CPPUNIT_ASSERT_EQUAL("broken library"s, mruby.execute(
+      "begin; Broken; rescue => e; e.message; end").as<std::string>());
+    CPPUNIT_ASSERT_THROW(mruby.execute("Flaky::TRIES"), std::exception);
+    CPPUNIT_ASSERT_EQUAL(2, mruby.execute("Flaky::TRIES").as<int>());
+    CPPUNIT_ASSERT_THROW(mruby.execute("Invalid"), std::exception);
+    CPPUNIT_ASSERT_THROW(mruby.execute("Invalid"), std::exception);
+
+    std::vector<std::string> expected = { "Flaky" };
+    CPPUNIT_ASSERT(expected == mruby.autoloaded());
+  }
+
+  void test_autoload_top_level() {
+    mrbind17::interpreter mruby;
+    std::string path = "interpreter_test_widget.rb";
+    {
+      std::ofstream f(path);
+      f << "$library_self = self.to_s\n"
+           "def shout(s); s.upcase; end\n"
+           "WIDGET_COUNT = 3\n"
+           "class Widget\n  def self.make; 'widget'; end\nend\n";
+    }
+    mruby.autoload_file("Widget", path);
+
+    // referenced from a nested module, the library still runs at top level
+    CPPUNIT_ASSERT_EQUAL("widget"s, mruby.execute("module Outer; Widget.make; end").as<std::string>());
+    std::remove(path.c_str());
+    CPPUNIT_ASSERT_EQUAL("main"s, mruby.execute("$library_self").as<std::string>());
+    CPPUNIT_ASSERT(mruby.execute("Object.const_defined?(:Widget) && Widget.name == 'Widget'").as<bool>());
+    CPPUNIT_ASSERT_EQUAL(3, mruby.execute("WIDGET_COUNT").as<int>());
+    CPPUNIT_ASSERT_EQUAL("ABC"s, mruby.execute("shout('abc')").as<std::string>());
+    CPPUNIT_ASSERT(!mruby.execute("Module.const_defined?(:Widget, false)").as<bool>());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( interpreter_test );
@@ -0,0 +1,112 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+class iterable_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( iterable_test );
+    CPPUNIT_TEST( test_iterate_container );
+    CPPUNIT_TEST( test_iterate_reference );
+    CPPUNIT_TEST( test_generator_on_demand );
+    CPPUNIT_TEST( test_enumerator );
+    CPPUNIT_TEST( test_uninitialized );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_iterate_container() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("names", []() {
+            return mrbind17::iterate(std::vector<std::string>{ "a", "b", "c" });
+        });
+        mruby.def_function("numbers", [](int n) {
+            std::vector<int> v;
+            for(int i = 0; i < n; i++) v.push_back(i);
+            return mrbind17::iterate(std::move(v));
+        });
+
+        CPPUNIT_ASSERT_EQUAL("abc"s, mruby.execute("s = ''; names.each { |x| s << x }; s").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(4950, mruby.execute("numbers(100).inject(0) { |a, b| a + b }").as<int>());
+        CPPUNIT_ASSERT_EQUAL(3, mruby.execute("numbers(10).select { |x| x % 4 == 0 }.size").as<int>());
+        // the same iterable can be enumerated several times
+        CPPUNIT_ASSERT_EQUAL(20, mruby.execute("n = numbers(10); n.to_a.size + n.to_a.size").as<int>());
+    }
+
+    void test_iterate_reference() {
+        mrbind17::interpreter mruby;
+        static std::vector<int> values = { 1, 2, 3, 4 };
+        mruby.def_function("values", []() {
+            return mrbind17::iterate(std::ref(values));
+        });
+        mruby.def_function("middle", []() {
+            return mrbind17::iterate(values.begin() + 1, values.end() - 1);
+        });
+
+        CPPUNIT_ASSERT_EQUAL(10, mruby.execute("values.inject(0) { |a, b| a + b }").as<int>());
+        values.push_back(5);
+        CPPUNIT_ASSERT_EQUAL(15, mruby.execute("values.inject(0) { |a, b| a + b }").as<int>());
+        CPPUNIT_ASSERT_EQUAL(9, mruby.execute("middle.inject(0) { |a, b| a + b }").as<int>());
+    }
+
+    void test_generator_on_demand() {
+        mrbind17::interpreter mruby;
+        static int produced = 0;
+        mruby.def_function("rows", [](int n) {
+            produced = 0;
+            return mrbind17::generate([n, i = 0]() mutable -> std::optional<int> {
+                if(i == n) return std::nullopt;
+                produced++;
+                return i++;
+            });
+        });
+
+        CPPUNIT_ASSERT_EQUAL(45, mruby.execute("rows(1000000).first(10).inject(0) { |a, b| a + b }").as<int>());
+        CPPUNIT_ASSERT_EQUAL(10, produced);
+
+        CPPUNIT_ASSERT_EQUAL(5, mruby.execute("rows(1000000).each { |x| break x if x == 5 }").as<int>());
+        CPPUNIT_ASSERT_EQUAL(6, produced);
+
+        // an exception raised by the block stops the iteration
+        CPPUNIT_ASSERT_EQUAL("stop at 2"s, mruby.execute(
+            "begin; rows(1000000).each { |x| raise \"stop at #{x}\" if x == 2 }; rescue => e; e.message; end").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(3, produced);
+
+        CPPUNIT_ASSERT_EQUAL(3, mruby.execute("rows(3).to_a.size").as<int>());
+    }
+
+    void test_enumerator() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("numbers", [](int n) {
+            std::vector<int> v;
+            for(int i = 0; i < n; i++) v.push_back(i);
+            return mrbind17::iterate(std::move(v));
+        });
+
+        CPPUNIT_ASSERT_EQUAL(1, mruby.execute("e = numbers(5).each; e.next; e.next").as<int>());
+        CPPUNIT_ASSERT_EQUAL(3, mruby.execute("numbers(100).take(3).size").as<int>());
+        CPPUNIT_ASSERT_EQUAL(36, mruby.execute(
+            "numbers(1000).lazy.map { |x| x * 2 }.select { |x| x % 3 == 0 }.first(4).inject(0) { |a, b| a + b }").as<int>());
+    }
+
+    void test_uninitialized() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("numbers", []() {
+            return mrbind17::iterate(std::vector<int>{ 1, 2 });
+        });
+        mruby.execute("numbers");
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("CppIterable.new.each { }"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("CppIterable.allocate.each { }"), std::exception);
+        CPPUNIT_ASSERT_EQUAL(3, mruby.execute("numbers.inject(:+)").as<int>());
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( iterable_test );
@@ -13,6 +13,7 @@ class module_test : public CppUnit::TestFixture {
   CPPUNIT_TEST( test_def_module );
   CPPUNIT_TEST( test_def_const );
   CPPUNIT_TEST( test_undefined_const );
+  CPPUNIT_TEST( test_class_var );
   CPPUNIT_TEST_SUITE_END();
 
   public:
@@ -65,6 +66,21 @@ class module_test : public CppUnit::TestFixture {
     CPPUNIT_ASSERT_THROW(mruby.execute(code.c_str()), std::runtime_error);
   }
 
+  void test_class_var() {
+    mrbind17::interpreter mruby;
+
+    auto mod = mruby.def_module("MyModule");
+    mrbind17::class_var<int> count(mod, "@@count");
+
+    CPPUNIT_ASSERT(!count.defined());
+    CPPUNIT_ASSERT(!mod.cv_defined(count.sym()));
+    count = 42;
+    CPPUNIT_ASSERT(mod.cv_defined("@@count"));
+    CPPUNIT_ASSERT_EQUAL(42, mod.cv_get(count.sym()).as<int>());
+    mod.cv_set(mod.intern("@@count"), 43);
+    CPPUNIT_ASSERT_EQUAL(43, count.get());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( module_test );
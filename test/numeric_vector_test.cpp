@@ -0,0 +1,125 @@
+#include <mrbind17/mrbind17.hpp>
+#include <mrbind17/numeric_vector.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std::string_literals;
+
+class numeric_vector_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( numeric_vector_test );
+    CPPUNIT_TEST( test_kernels );
+    CPPUNIT_TEST( test_scalar_fallback );
+    CPPUNIT_TEST( test_ruby_class );
+    CPPUNIT_TEST( test_bound_function );
+    CPPUNIT_TEST( test_size_mismatch );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {
+        mrbind17::numeric_vector::set_simd_level(mrbind17::simd_level::avx2);
+    }
+
+    void check_kernels() {
+        std::vector<double> a, b;
+        for(int i = 0; i < 37; i++) {
+            a.push_back(i - 10.5);
+            b.push_back(2.0 * i);
+        }
+        mrbind17::numeric_vector va(a), vb(b);
+        auto sum = va + vb;
+        auto prod = va * 2.0;
+        auto clamped = va.clamp(-1.0, 1.0);
+        auto mask = va.lt(vb);
+        double expected_dot = 0.0, expected_sum = 0.0;
+        for(size_t i = 0; i < a.size(); i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(a[i] + b[i], sum[i], 1e-12);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(a[i] * 2.0, prod[i], 1e-12);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL(std::min(std::max(a[i], -1.0), 1.0), clamped[i], 1e-12);
+            CPPUNIT_ASSERT_EQUAL(a[i] < b[i] ? 1.0 : 0.0, mask[i]);
+            expected_dot += a[i] * b[i];
+            expected_sum += a[i];
+        }
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(expected_sum, va.sum(), 1e-9);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(expected_dot, va.dot(vb), 1e-9);
+        CPPUNIT_ASSERT_EQUAL(-10.5, va.min());
+        CPPUNIT_ASSERT_EQUAL(25.5, va.max());
+    }
+
+    void test_kernels() {
+        check_kernels();
+    }
+
+    void test_scalar_fallback() {
+        mrbind17::numeric_vector::set_simd_level(mrbind17::simd_level::scalar);
+        CPPUNIT_ASSERT(mrbind17::numeric_vector::active_simd_level() == mrbind17::simd_level::scalar);
+        check_kernels();
+    }
+
+    void test_ruby_class() {
+        mrbind17::interpreter mruby;
+
+        mrbind17::def_numeric_vector(mruby);
+
+        std::string code = R"ruby(
+            v = NumericVector.new([1, 2, 3, 4.5])
+            w = NumericVector.new(4, 2.0)
+            r = (v * w + 1).clamp(0, 8)
+            [r.to_a, v.dot(w), v.sum, v.min, v.max, v.gt(2).sum, r[-1], NumericVector.new.max]
+        )ruby";
+
+        CPPUNIT_ASSERT_NO_THROW(mruby.execute(code.c_str()));
+        mruby.set_global("$result", mruby.execute(code.c_str()).value());
+        CPPUNIT_ASSERT(mruby.execute(
+            "$result == [[3.0, 5.0, 7.0, 8.0], 21.0, 10.5, 1.0, 4.5, 2.0, 8.0, nil]").as<bool>());
+    }
+
+    void test_bound_function() {
+        mrbind17::interpreter mruby;
+
+        mrbind17::def_numeric_vector(mruby);
+        mruby.def_function("normalize", [](const mrbind17::numeric_vector& v) {
+            return v / v.sum();
+        });
+
+        std::string code = R"ruby(
+            normalize([1, 1, 2]).to_a == [0.25, 0.25, 0.5] &&
+            normalize(NumericVector.new([2, 2])).to_a == [0.5, 0.5]
+        )ruby";
+
+        CPPUNIT_ASSERT(mruby.execute(code.c_str()).as<bool>());
+
+        // references refer to the wrapped vector, without copying it
+        mruby.def_function("same", [](const mrbind17::numeric_vector& a, const mrbind17::numeric_vector& b) {
+            return &a == &b;
+        });
+        mruby.def_function("scale!", [](mrbind17::numeric_vector& v, double k) {
+            for(size_t i = 0; i < v.size(); i++) v[i] *= k;
+        });
+        CPPUNIT_ASSERT(mruby.execute("v = NumericVector.new([1, 2]); same(v, v)").as<bool>());
+        CPPUNIT_ASSERT(!mruby.execute("a = [1, 2]; same(a, a)").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("v = NumericVector.new([1, 2]); scale!(v, 3); v.to_a == [3.0, 6.0]").as<bool>());
+        CPPUNIT_ASSERT(mruby.execute("a = [1, 2]; scale!(a, 3); a == [1, 2]").as<bool>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("scale!(['x'], 3)"), std::bad_function_call);
+    }
+
+    void test_size_mismatch() {
+        mrbind17::interpreter mruby;
+
+        mrbind17::def_numeric_vector(mruby);
+
+        std::string code = R"ruby(
+            NumericVector.new([1, 2]) + NumericVector.new([1, 2, 3])
+        )ruby";
+
+        CPPUNIT_ASSERT_THROW(mruby.execute(code.c_str()), std::runtime_error);
+        CPPUNIT_ASSERT_THROW(mrbind17::numeric_vector({1.0}) + mrbind17::numeric_vector(), std::invalid_argument);
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( numeric_vector_test );
@@ -0,0 +1,93 @@
+#include <mrbind17/mrbind17.hpp>
+#include <mrbind17/profiler.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+class profiler_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( profiler_test );
+    CPPUNIT_TEST( test_collapsed_stacks );
+    CPPUNIT_TEST( test_bounded_stacks );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    static void busy_wait(int ms) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        while(std::chrono::steady_clock::now() < end) {}
+    }
+
+    void test_collapsed_stacks() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("busy_wait", busy_wait);
+
+        mrbind17::profiler prof(mruby, std::chrono::microseconds(200));
+#ifdef MRB_ENABLE_DEBUG_HOOK
+        prof.start();
+        CPPUNIT_ASSERT(prof.running());
+        mruby.execute(R"ruby(
+            def inner; busy_wait(20); end
+            def outer; inner; end
+            outer
+            x = 0
+            100000.times { |i| x += i }
+        )ruby");
+        prof.stop();
+        CPPUNIT_ASSERT(!prof.running());
+
+        CPPUNIT_ASSERT(prof.samples() > 0);
+        std::string out = prof.collapsed();
+        CPPUNIT_ASSERT(out.find("outer") != std::string::npos);
+        CPPUNIT_ASSERT(out.find("inner") != std::string::npos);
+        CPPUNIT_ASSERT(out.find(";busy_wait ") != std::string::npos);
+
+        std::istringstream lines(out);
+        std::string line;
+        size_t total = 0;
+        while(std::getline(lines, line)) {
+            auto space = line.rfind(' ');
+            CPPUNIT_ASSERT(space != std::string::npos);
+            CPPUNIT_ASSERT(line.compare(0, 6, "<main>") == 0);
+            total += std::stoul(line.substr(space + 1));
+        }
+        CPPUNIT_ASSERT_EQUAL(prof.samples(), total);
+
+        prof.reset();
+        CPPUNIT_ASSERT_EQUAL((size_t)0, prof.samples());
+        CPPUNIT_ASSERT(prof.collapsed().empty());
+#else
+        CPPUNIT_ASSERT_THROW(prof.start(), std::runtime_error);
+#endif
+    }
+
+    void test_bounded_stacks() {
+#ifdef MRB_ENABLE_DEBUG_HOOK
+        mrbind17::interpreter mruby;
+        mruby.def_function("busy_wait", busy_wait);
+
+        mrbind17::profiler prof(mruby, std::chrono::microseconds(200), 1);
+        prof.start();
+        mruby.execute(R"ruby(
+            def a; busy_wait(10); end
+            def b; busy_wait(10); end
+            def c; busy_wait(10); end
+            a; b; c
+        )ruby");
+        prof.stop();
+
+        std::string out = prof.collapsed();
+        CPPUNIT_ASSERT(out.find("[other] ") != std::string::npos);
+        size_t lines = 0;
+        for(char ch : out) if(ch == '\n') lines += 1;
+        CPPUNIT_ASSERT(lines <= 2);
+#endif
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( profiler_test );
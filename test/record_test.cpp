@@ -0,0 +1,123 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+struct color {
+    int r = 0;
+    int g = 0;
+    int b = 0;
+};
+
+struct shape {
+    std::string                name;
+    color                      fill;
+    std::vector<double>        xs;
+    std::vector<color>         palette;
+    std::map<std::string, int> tags;
+};
+
+struct sample {
+    double value = 0.0;
+    bool   valid = false;
+};
+
+MRBIND17_RECORD(color, r, g, b);
+MRBIND17_RECORD(shape, name, fill, xs, palette, tags);
+
+template<> struct mrbind17::record_traits<sample> {
+    static constexpr auto fields = std::make_tuple(
+        mrbind17::field("value", &sample::value),
+        mrbind17::field("valid", &sample::valid));
+};
+
+class record_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( record_test );
+    CPPUNIT_TEST( test_hash );
+    CPPUNIT_TEST( test_struct );
+    CPPUNIT_TEST( test_nested );
+    CPPUNIT_TEST( test_invalid );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_hash() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("gray", [](int v) { return color{ v, v, v }; });
+        mruby.def_function("sum", [](const color& c) { return c.r + c.g + c.b; });
+        mruby.def_function("measure", [](double v) { return sample{ v, v >= 0 }; });
+
+        CPPUNIT_ASSERT_EQUAL(7, mruby.execute("gray(7)[:g]").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("gray(7) == { r: 7, g: 7, b: 7 }").as<bool>());
+        CPPUNIT_ASSERT_EQUAL(6, mruby.execute("sum({ r: 1, g: 2, b: 3 })").as<int>());
+        // missing keys leave the fields default-initialized
+        CPPUNIT_ASSERT_EQUAL(4, mruby.execute("sum({ b: 4 })").as<int>());
+        CPPUNIT_ASSERT(!mruby.execute("measure(-1.0)[:valid]").as<bool>());
+
+        auto c = mruby.execute("{ r: 10, g: 20, b: 30 }").as<color>();
+        CPPUNIT_ASSERT_EQUAL(20, c.g);
+    }
+
+    void test_struct() {
+        mrbind17::interpreter mruby;
+        mruby.def_record<color>("Color");
+        mruby.def_function("gray", [](int v) { return color{ v, v, v }; });
+        mruby.def_function("sum", [](const color& c) { return c.r + c.g + c.b; });
+
+        CPPUNIT_ASSERT_EQUAL("Color"s, mruby.execute("gray(1).class.to_s").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(5, mruby.execute("gray(5).b").as<int>());
+        CPPUNIT_ASSERT_EQUAL(6, mruby.execute("sum(Color.new(1, 2, 3))").as<int>());
+        // hashes are still accepted
+        CPPUNIT_ASSERT_EQUAL(3, mruby.execute("sum({ r: 3 })").as<int>());
+        CPPUNIT_ASSERT_EQUAL(30, mruby.execute("c = gray(5); c.g = 20; sum(c)").as<int>());
+    }
+
+    void test_nested() {
+        mrbind17::interpreter mruby;
+        mruby.def_record<color>("Color");
+        mruby.def_function("make_shape", []() {
+            shape s;
+            s.name = "square";
+            s.fill = { 1, 2, 3 };
+            s.xs = { 0.0, 1.0, 1.0, 0.0 };
+            s.palette = { { 255, 0, 0 }, { 0, 255, 0 } };
+            s.tags = { { "layer", 2 } };
+            return s;
+        });
+        mruby.def_function("roundtrip", [](const shape& s) { return s; });
+
+        CPPUNIT_ASSERT_EQUAL(2, mruby.execute("make_shape[:fill].g").as<int>());
+        CPPUNIT_ASSERT_EQUAL(255, mruby.execute("make_shape[:palette][1].g").as<int>());
+        CPPUNIT_ASSERT_EQUAL(2, mruby.execute("make_shape[:tags]['layer']").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("make_shape == roundtrip(make_shape)").as<bool>());
+
+        auto s = mruby.execute(
+            "{ name: 'tri', fill: { r: 9 }, xs: [1, 2.5], palette: [Color.new(1, 1, 1)], tags: { 'a' => 1 } }"
+        ).as<shape>();
+        CPPUNIT_ASSERT_EQUAL("tri"s, s.name);
+        CPPUNIT_ASSERT_EQUAL(9, s.fill.r);
+        CPPUNIT_ASSERT_EQUAL(size_t(2), s.xs.size());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(2.5, s.xs[1], 1e-9);
+        CPPUNIT_ASSERT_EQUAL(1, s.palette[0].b);
+        CPPUNIT_ASSERT_EQUAL(1, s.tags["a"]);
+    }
+
+    void test_invalid() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("sum", [](const color& c) { return c.r + c.g + c.b; });
+        mruby.def_function("points", [](const shape& s) { return s.xs.size(); });
+
+        CPPUNIT_ASSERT_THROW(mruby.execute("sum(3)"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("sum({ r: 'red' })"), std::exception);
+        CPPUNIT_ASSERT_THROW(mruby.execute("points({ xs: [1, 'two'] })"), std::exception);
+    }
+
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( record_test );
@@ -0,0 +1,83 @@
+#include <mrbind17/mrbind17.hpp>
+#include <mrbind17/serialization.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <iostream>
+
+using namespace std::string_literals;
+
+class serialization_test : public CppUnit::TestFixture {
+
+  CPPUNIT_TEST_SUITE( serialization_test );
+  CPPUNIT_TEST( test_round_trip );
+  CPPUNIT_TEST( test_streaming_writer );
+  CPPUNIT_TEST( test_unsupported_type );
+  CPPUNIT_TEST( test_truncated );
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+
+  void setUp() {}
+  void tearDown() {}
+
+  void test_round_trip() {
+    mrbind17::interpreter source;
+    mrbind17::interpreter target;
+
+    auto value = source.execute(R"ruby(
+      [nil, true, false, -42, 1 << 40, 3.5, "Matthieu", :sym,
+       { "a" => [1, 2, 3], :b => { 1 => 2.5 } }]
+    )ruby");
+    std::string data = mrbind17::serialize(value);
+
+    target.set_global("$value", mrbind17::deserialize(target, data).value());
+    std::string code = R"ruby(
+      $value == [nil, true, false, -42, 1 << 40, 3.5, "Matthieu", :sym,
+                 { "a" => [1, 2, 3], :b => { 1 => 2.5 } }]
+    )ruby";
+    CPPUNIT_ASSERT(target.execute(code.c_str()).as<bool>());
+  }
+
+  void test_streaming_writer() {
+    mrbind17::interpreter mruby;
+
+    std::string data;
+    mrbind17::binary_writer writer(data);
+    writer.begin_hash(2);
+    writer.write_symbol("name");
+    writer.write_string("Lucas");
+    writer.write_symbol("scores");
+    writer.begin_array(3);
+    for(int i = 1; i <= 3; i++) writer.write_int(i*10);
+    writer.write_float(0.25);
+
+    mrbind17::binary_reader reader(data);
+    mruby.set_global("$h", reader.read(mruby.mrb()));
+    mruby.set_global("$f", reader.read(mruby.mrb()));
+    CPPUNIT_ASSERT(reader.at_end());
+
+    std::string code = R"ruby(
+      $h == { name: "Lucas", scores: [10, 20, 30] } && $f == 0.25
+    )ruby";
+    CPPUNIT_ASSERT(mruby.execute(code.c_str()).as<bool>());
+  }
+
+  void test_unsupported_type() {
+    mrbind17::interpreter mruby;
+
+    auto value = mruby.execute("[1, Object.new]");
+    CPPUNIT_ASSERT_THROW(mrbind17::serialize(value), std::runtime_error);
+  }
+
+  void test_truncated() {
+    mrbind17::interpreter source;
+    mrbind17::interpreter target;
+
+    std::string data = mrbind17::serialize(source.execute("[1, 2, \"three\"]"));
+    data.resize(data.size() - 2);
+    CPPUNIT_ASSERT_THROW(mrbind17::deserialize(target, data), std::runtime_error);
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( serialization_test );
@@ -0,0 +1,136 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class trace_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( trace_test );
+    CPPUNIT_TEST( test_events );
+    CPPUNIT_TEST( test_disabled );
+    CPPUNIT_TEST( test_callback );
+    CPPUNIT_TEST( test_ring_buffer );
+    CPPUNIT_TEST( test_chrome_json );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {
+        mrbind17::tracing::clear();
+        mrbind17::tracing::enable();
+    }
+
+    void tearDown() {
+        mrbind17::tracing::disable();
+        mrbind17::tracing::set_callback(nullptr);
+    }
+
+    static size_t count(const std::vector<mrbind17::trace_event>& events,
+                        char phase, const std::string& name) {
+        return std::count_if(events.begin(), events.end(), [&](const auto& e) {
+            return e.phase == phase && name == e.name;
+        });
+    }
+
+    void test_events() {
+        mrbind17::interpreter mruby;
+        mruby.def_function("add", [](int x, int y) { return x + y; });
+
+        mruby.execute("add(1, 2) + add(3, 4)");
+        mruby.full_gc();
+
+        auto events = mrbind17::tracing::collect();
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count(events, 'B', "execute"));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count(events, 'E', "execute"));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count(events, 'B', "compile"));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count(events, 'E', "compile"));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, count(events, 'B', "add"));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, count(events, 'E', "add"));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count(events, 'B', "full_gc"));
+
+        // events are properly nested
+        std::vector<std::string> stack;
+        for(const auto& e : events) {
+            if(e.phase == 'B') {
+                stack.push_back(e.name);
+            } else {
+                CPPUNIT_ASSERT(!stack.empty());
+                CPPUNIT_ASSERT_EQUAL(stack.back(), std::string(e.name));
+                stack.pop_back();
+            }
+        }
+        CPPUNIT_ASSERT(stack.empty());
+        CPPUNIT_ASSERT(events.front().timestamp <= events.back().timestamp);
+    }
+
+    void test_disabled() {
+        mrbind17::tracing::disable();
+        mrbind17::interpreter mruby;
+        mruby.execute("1 + 1");
+        CPPUNIT_ASSERT(mrbind17::tracing::collect().empty());
+    }
+
+    void test_callback() {
+        std::vector<std::string> names;
+        mrbind17::tracing::set_callback([&names](const mrbind17::trace_event& e) {
+            names.push_back(std::string(1, e.phase) + e.name);
+        });
+
+        mrbind17::interpreter mruby;
+        mruby.execute("1 + 1");
+
+        std::vector<std::string> expected = { "Bexecute", "Bcompile", "Ecompile", "Eexecute" };
+        CPPUNIT_ASSERT(names == expected);
+    }
+
+    void test_ring_buffer() {
+        mrbind17::tracing::set_buffer_capacity(8);
+        std::vector<mrbind17::trace_event> events;
+        std::thread t([&events]() {
+            mrbind17::interpreter mruby;
+            mruby.def_function("f", []() {});
+            mruby.execute("100.times { f }");
+            events = mrbind17::tracing::collect();
+        });
+        t.join();
+        mrbind17::tracing::set_buffer_capacity(16384);
+
+        auto tid = events.back().thread_id;
+        CPPUNIT_ASSERT_EQUAL((long)8, (long)std::count_if(events.begin(), events.end(),
+            [tid](const auto& e) { return e.thread_id == tid; }));
+        // the most recent events are kept
+        CPPUNIT_ASSERT_EQUAL(std::string("execute"), std::string(events.back().name));
+        CPPUNIT_ASSERT_EQUAL('E', events.back().phase);
+    }
+
+    void test_chrome_json() {
+        mrbind17::interpreter mruby;
+        mruby.execute("1");
+
+        std::ostringstream ss;
+        mrbind17::tracing::write_chrome_json(ss);
+        std::string json = ss.str();
+        CPPUNIT_ASSERT(json.compare(0, 16, "{\"traceEvents\":[") == 0);
+        CPPUNIT_ASSERT(json.find("{\"name\":\"execute\",\"cat\":\"execute\",\"ph\":\"B\",\"ts\":") != std::string::npos);
+        CPPUNIT_ASSERT(json.find("\"ph\":\"E\"") != std::string::npos);
+
+        std::vector<mrbind17::trace_event> events(1);
+        events[0].timestamp = 1234567;
+        events[0].thread_id = 3;
+        events[0].phase     = 'B';
+        events[0].category  = mrbind17::trace_category::call;
+        std::strcpy(events[0].name, "a\"b");
+        std::ostringstream ss2;
+        mrbind17::tracing::write_chrome_json(ss2, events);
+        CPPUNIT_ASSERT_EQUAL(std::string(
+            "{\"traceEvents\":[{\"name\":\"a\\\"b\",\"cat\":\"call\",\"ph\":\"B\",\"ts\":1234.567,\"pid\":0,\"tid\":3}],"
+            "\"displayTimeUnit\":\"ns\"}"), ss2.str());
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( trace_test );
@@ -0,0 +1,110 @@
+#include <mrbind17/mrbind17.hpp>
+#include <cppunit/extensions/HelperMacros.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+class view_test : public CppUnit::TestFixture {
+
+    CPPUNIT_TEST_SUITE( view_test );
+    CPPUNIT_TEST( test_array_view );
+    CPPUNIT_TEST( test_array_view_lazy );
+    CPPUNIT_TEST( test_hash_view );
+    CPPUNIT_TEST( test_hash_view_iteration );
+    CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+    void setUp() {}
+    void tearDown() {}
+
+    void test_array_view() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_function("sum", [](mrbind17::array_view<int> v) {
+            int s = 0;
+            for(int x : v) s += x;
+            return s;
+        });
+        mruby.def_function("nth", [](const mrbind17::array_view<std::string>& v, int i) {
+            return v.at(i);
+        });
+        mruby.def_function("largest", [](mrbind17::array_view<double> v) {
+            return *std::max_element(v.begin(), v.end());
+        });
+
+        CPPUNIT_ASSERT_EQUAL(10, mruby.execute("sum([1, 2, 3, 4])").as<int>());
+        CPPUNIT_ASSERT_EQUAL(0, mruby.execute("sum([])").as<int>());
+        CPPUNIT_ASSERT_EQUAL("b"s, mruby.execute("nth(['a', 'b', 'c'], 1)").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(4.5, mruby.execute("largest([1.0, 4.5, 2.0])").as<double>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("nth(['a'], 3)"), std::out_of_range);
+        CPPUNIT_ASSERT_THROW(mruby.execute("sum({})"), std::bad_function_call);
+    }
+
+    void test_array_view_lazy() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_function("first", [](mrbind17::array_view<int> v) {
+            return v.front();
+        });
+        mruby.def_function("size", [](mrbind17::array_view<int> v) {
+            return v.size();
+        });
+
+        // Only accessed elements are converted
+        CPPUNIT_ASSERT_EQUAL(1, mruby.execute("first([1, 'two', :three])").as<int>());
+        CPPUNIT_ASSERT_EQUAL(3, mruby.execute("size([1, 'two', :three])").as<int>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("first(['one', 2])"), std::invalid_argument);
+    }
+
+    void test_hash_view() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_function("lookup", [](mrbind17::hash_view<std::string, int> h, const std::string& key) {
+            return h.find(key).value_or(-1);
+        });
+        mruby.def_function("has", [](mrbind17::hash_view<std::string, int> h, const std::string& key) {
+            return h.contains(key);
+        });
+        mruby.def_function("fetch", [](mrbind17::hash_view<int, std::string> h, int key) {
+            return h.at(key);
+        });
+
+        std::string code = R"ruby(
+            $h = { "a" => 1, "b" => 2, "c" => "not an int" }
+        )ruby";
+        mruby.execute(code.c_str());
+
+        CPPUNIT_ASSERT_EQUAL(2, mruby.execute("lookup($h, 'b')").as<int>());
+        CPPUNIT_ASSERT_EQUAL(-1, mruby.execute("lookup($h, 'z')").as<int>());
+        CPPUNIT_ASSERT(mruby.execute("has($h, 'c')").as<bool>());
+        CPPUNIT_ASSERT(!mruby.execute("has($h, 'd')").as<bool>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("lookup($h, 'c')"), std::invalid_argument);
+        CPPUNIT_ASSERT_EQUAL("x"s, mruby.execute("fetch({ 1 => 'x' }, 1)").as<std::string>());
+        CPPUNIT_ASSERT_THROW(mruby.execute("fetch({ 1 => 'x' }, 2)"), std::out_of_range);
+        CPPUNIT_ASSERT_THROW(mruby.execute("fetch([], 2)"), std::bad_function_call);
+    }
+
+    void test_hash_view_iteration() {
+        mrbind17::interpreter mruby;
+
+        mruby.def_function("keys", [](mrbind17::hash_view<std::string, double> h) {
+            std::string keys;
+            double total = 0.0;
+            for(const auto& [k, v] : h) {
+                keys += k;
+                total += v;
+            }
+            return keys + ":" + std::to_string(static_cast<int>(total)) + ":" + std::to_string(h.size());
+        });
+
+        CPPUNIT_ASSERT_EQUAL("xyz:6:3"s,
+            mruby.execute("keys({ 'x' => 1.0, 'y' => 2.0, 'z' => 3.0 })").as<std::string>());
+        CPPUNIT_ASSERT_EQUAL(":0:0"s, mruby.execute("keys({})").as<std::string>());
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( view_test );